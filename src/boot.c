@@ -1,5 +1,12 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "boot.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 int BootLoadRom(uint8_t rom[0x100]) {
   const char* BootRomPath = "boot/DMG_ROM.bin";  //"boot/DMG_ROM.bin";
   //
@@ -25,28 +32,35 @@ int BootLoadRom(uint8_t rom[0x100]) {
   return BOOT_OK;
 }
 
-int BootLoadTestRom(uint8_t** rom, const char* fileName) {
-  const char* BootRomPath = fileName;
-  FILE* file = fopen(BootRomPath, "rb");
+int BootMapRom(struct cart* cart, const char* fileName) {
+  struct stat st;
 
-  if (!file) {
-    printf("[ERROR] %s: file %s not found!\n", __func__, BootRomPath);
+  cart->fd = open(fileName, O_RDONLY);
+  if (cart->fd < 0) {
+    printf("[ERROR] %s: file %s not found!\n", __func__, fileName);
+    return BOOT_ERROR_FILE;
+  }
+  if (fstat(cart->fd, &st) || st.st_size == 0) {
+    printf("[ERROR] %s: %s is empty\n", __func__, fileName);
+    close(cart->fd);
     return BOOT_ERROR_FILE;
   }
 
-  fseek(file, 0L, SEEK_END);
-  size_t size = ftell(file);
-  rewind(file);
-
-  *rom = calloc(size, sizeof(uint8_t));
-
-  if (!*rom) {
-    printf("[ERROR] %s: no allocated rom for\n", __func__);
+  cart->size = st.st_size;
+  cart->data = mmap(NULL, cart->size, PROT_READ, MAP_SHARED, cart->fd, 0);
+  if (cart->data == MAP_FAILED) {
+    printf("[ERROR] %s: can't map %s\n", __func__, fileName);
+    close(cart->fd);
     return BOOT_ERROR_MEMORY;
   }
 
-  fread(*rom, size, 1, file);
-  fclose(file);
-
   return BOOT_OK;
 }
+
+void BootUnmapRom(struct cart* cart) {
+  if (!cart->data) return;
+
+  munmap((void*)cart->data, cart->size);
+  close(cart->fd);
+  cart->data = NULL;
+}
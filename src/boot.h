@@ -8,5 +8,14 @@
 #define BOOT_ERROR_MEMORY 1
 #define BOOT_ERROR_FILE 2
 
+// cartridge image, mapped read only so every machine running the same file
+// shares its pages through the page cache
+struct cart {
+  const uint8_t* data;
+  size_t size;
+  int fd;
+};
+
 int BootLoadRom(uint8_t rom[0x100]);
-int BootLoadTestRom(uint8_t** rom, const char* fileName);
+int BootMapRom(struct cart* cart, const char* fileName);
+void BootUnmapRom(struct cart* cart);
@@ -0,0 +1,72 @@
+#include "bus.h"
+
+#include "gb.h"
+#include "io.h"
+
+// reads of unmapped cart space, pulled up
+__extension__ static const uint8_t BusOpen[BUS_PAGE_SIZE] = {
+    [0 ... BUS_PAGE_SIZE - 1] = 0xFF};
+
+static uint8_t BusReadIo(struct gb* gb, uint16_t addr) {
+  if (addr == JOYP) return gb->ram[JOYP] | 0xCF;
+  if (addr == IF) return gb->ram[IF] | 0xE0;
+  if (addr == STAT) return gb->ram[STAT] | 0x80;
+  if (addr >= DIV && addr <= TAC) return TimerRead(gb, addr);
+  return gb->ram[addr];
+}
+
+// IO register and IE writes end the cpu batch, IoWrite applies them after
+static void BusWriteIo(struct gb* gb, struct cpu* cpu, uint16_t addr,
+                       uint8_t u8) {
+  if (addr == LY) return;  // the PPU's line counter, read only
+  if (addr == STAT) u8 = (u8 & 0x78) | (gb->ram[STAT] & 0x07);  // same
+  gb->ram[addr] = u8;
+  if (addr < 0xFF80 || addr == IE) {
+    cpu->io = addr;
+    cpu->yield = true;
+  }
+}
+
+// carts without a mapper, MbcInit replaces it for the others
+static void BusWriteRom(struct gb* gb, struct cpu* cpu, uint16_t addr,
+                        uint8_t u8) {}
+
+// points count pages from page on at the cart from offset, past its end
+// reads are open bus
+void BusMapCart(struct gb* gb, uint8_t page, uint32_t offset, uint8_t count) {
+  struct bus* bus = &gb->bus;
+
+  for (uint8_t i = 0; i < count; i++, offset += BUS_PAGE_SIZE)
+    bus->read[page + i] =
+        offset < gb->cart->size ? gb->cart->data + offset : BusOpen;
+}
+
+void BusInit(struct gb* gb, bool boot) {
+  struct bus* bus = &gb->bus;
+
+  bus->gb = gb;
+  for (int page = 0; page < BUS_PAGES; page++) {
+    bus->read[page] = gb->ram + page * BUS_PAGE_SIZE;
+    bus->write[page] = gb->ram + page * BUS_PAGE_SIZE;
+  }
+
+  // $0000-$7FFF BNK0 and BNK1 straight from the cart, writes to the mapper
+  BusMapCart(gb, 0x00, 0, 0x80);
+  for (int page = 0x00; page < 0x80; page++) {
+    bus->write[page] = NULL;
+    bus->writer[page] = BusWriteRom;
+  }
+  if (boot) bus->read[0x00] = gb->boot;  // until the write to BOOT
+
+  // $E000-$FDFF echo of WRAM
+  for (int page = 0xE0; page < 0xFE; page++) {
+    bus->read[page] = gb->ram + (page - 0x20) * BUS_PAGE_SIZE;
+    bus->write[page] = gb->ram + (page - 0x20) * BUS_PAGE_SIZE;
+  }
+
+  // $FF00-$FFFF IO registers, HRAM and IE
+  bus->read[0xFF] = NULL;
+  bus->write[0xFF] = NULL;
+  bus->reader[0xFF] = BusReadIo;
+  bus->writer[0xFF] = BusWriteIo;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cpu.h"
+
+// Memory bus, one page table entry per 256 bytes. Plain memory is a direct
+// pointer to the page, so an access is a single indexed load. Pages with side
+// effects (IO, MBC control) have no pointer and go to their handler.
+#define BUS_PAGES 0x100
+#define BUS_PAGE_SIZE 0x100
+
+struct gb;
+
+typedef uint8_t (*BusReader)(struct gb* gb, uint16_t addr);
+typedef void (*BusWriter)(struct gb* gb, struct cpu* cpu, uint16_t addr,
+                          uint8_t u8);
+
+struct bus {
+  const uint8_t* read[BUS_PAGES];  // NULL for handler pages
+  uint8_t* write[BUS_PAGES];
+  BusReader reader[BUS_PAGES];
+  BusWriter writer[BUS_PAGES];
+  struct gb* gb;
+};
+
+static inline uint8_t BusRead(const struct bus* bus, uint16_t addr) {
+  const uint8_t* page = bus->read[addr >> 010];
+  if (__builtin_expect(page != NULL, 1)) return page[addr & 0xFF];
+  return bus->reader[addr >> 010](bus->gb, addr);
+}
+
+// cpu is the one running
+static inline void BusWrite(const struct bus* bus, struct cpu* cpu,
+                            uint16_t addr, uint8_t u8) {
+  uint8_t* page = bus->write[addr >> 010];
+  if (__builtin_expect(page != NULL, 1))
+    page[addr & 0xFF] = u8;
+  else
+    bus->writer[addr >> 010](bus->gb, cpu, addr, u8);
+}
+
+void BusInit(struct gb* gb, bool boot);
+void BusMapCart(struct gb* gb, uint8_t page, uint32_t offset, uint8_t count);
@@ -1,5 +1,9 @@
 #include "cpu.h"
 
+#include "gb.h"
+#include "ops.h"
+#include "trace.h"
+
 // R  - 8 bit Register
 // RR - 16 bit Register
 // (--) - dereference at address
@@ -7,11 +11,15 @@
 // u8 - read 8 bit from ram
 // 00h - hexadecimal number literal
 
-int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
-            bool *hlt, uint8_t *cycles, bool *IME) {
-  static struct debug dbg = {.trace = DBG_CONTINUE};
+#if CPU_ENGINE == CPU_ENGINE_SWITCH
+int CpuStep(struct gb *gb, uint8_t *cycles) {
+  struct cpu *cpu = &gb->cpu;
+  struct debug *dbg = &gb->dbg;
+  uint16_t *pc = &cpu->pc, *sp = &cpu->sp;
+  struct Registers *reg = &cpu->reg;
+  bool *hlt = &cpu->hlt, *IME = &cpu->ime;
 
-  uint8_t opcode = ram[*pc];
+  uint8_t opcode = Read8(cpu, *pc);
   if (opcode) DEBUG_PRINT(MAG "$%04X:%02X \t" RESET, *pc, opcode);
   if (*sp == 0x0) {
     printf("[ERROR] SP underflowing\n");
@@ -29,38 +37,38 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
      *  8-Bit Loads
      *-------------*/
     case 0x06:  // LD B, u8
-      B = ram[++*pc];
-      DEBUG_PRINT("[INSTR] LD B, $%02X\n", ram[*pc]);
+      B = Read8(cpu, ++*pc);
+      DEBUG_PRINT("[INSTR] LD B, $%02X\n", Read8(cpu, *pc));
       ++*pc;
       *cycles = 8;
       break;
     case 0x0E:  // LD C, u8
-      C = ram[++*pc];
-      DEBUG_PRINT("[INSTR] LD C, $%02X\n", ram[*pc]);
+      C = Read8(cpu, ++*pc);
+      DEBUG_PRINT("[INSTR] LD C, $%02X\n", Read8(cpu, *pc));
       ++*pc;
       *cycles = 8;
       break;
     case 0x16:  // LD D, u8
-      D = ram[++*pc];
-      DEBUG_PRINT("[INSTR] LD D, $%02X\n", ram[*pc]);
+      D = Read8(cpu, ++*pc);
+      DEBUG_PRINT("[INSTR] LD D, $%02X\n", Read8(cpu, *pc));
       ++*pc;
       *cycles = 8;
       break;
     case 0x1E:  // LD E, u8
-      E = ram[++*pc];
-      DEBUG_PRINT("[INSTR] LD E, $%02X\n", ram[*pc]);
+      E = Read8(cpu, ++*pc);
+      DEBUG_PRINT("[INSTR] LD E, $%02X\n", Read8(cpu, *pc));
       ++*pc;
       *cycles = 8;
       break;
     case 0x26:  // LD H, u8
-      H = ram[++*pc];
-      DEBUG_PRINT("[INSTR] LD H, $%02X\n", ram[*pc]);
+      H = Read8(cpu, ++*pc);
+      DEBUG_PRINT("[INSTR] LD H, $%02X\n", Read8(cpu, *pc));
       ++*pc;
       *cycles = 8;
       break;
     case 0x2E:  // LD L, u8
-      L = ram[++*pc];
-      DEBUG_PRINT("[INSTR] LD L, $%02X\n", ram[*pc]);
+      L = Read8(cpu, ++*pc);
+      DEBUG_PRINT("[INSTR] LD L, $%02X\n", Read8(cpu, *pc));
       ++*pc;
       *cycles = 8;
       break;
@@ -108,36 +116,36 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
       *cycles = 4;
       break;
     case 0x0A:  // LD A, (BC)
-      A = ram[BC];
+      A = Read8(cpu, BC);
       DEBUG_PRINT("[INSTR] LD A, (BC)\n");
       ++*pc;
       *cycles = 8;
       break;
     case 0x1A:  // LD A, (DE)
-      A = ram[DE];
+      A = Read8(cpu, DE);
       DEBUG_PRINT("[INSTR] LD A, (DE)\n");
       ++*pc;
       *cycles = 8;
       break;
     case 0x7E:  // LD A, (HL)
-      A = ram[HL];
+      A = Read8(cpu, HL);
       DEBUG_PRINT("[INSTR] LD A, (HL)\n");
       ++*pc;
       *cycles = 8;
       break;
     case 0xFA:  // LD A, (u16)
     {
-      uint16_t u16 = ram[*pc + 1] | ram[*pc + 2] << 010;
+      uint16_t u16 = Read8(cpu, *pc + 1) | Read8(cpu, *pc + 2) << 010;
       *pc += 2;
-      A = ram[u16];
+      A = Read8(cpu, u16);
       DEBUG_PRINT("[INSTR] LD A, ($%04X)\n", u16);
       ++*pc;
       *cycles = 16;
       break;
     }
     case 0x3E:  // LD A, u8
-      A = ram[++*pc];
-      DEBUG_PRINT("[INSTR] LD A, $%02X\n", ram[*pc]);
+      A = Read8(cpu, ++*pc);
+      DEBUG_PRINT("[INSTR] LD A, $%02X\n", Read8(cpu, *pc));
       ++*pc;
       *cycles = 8;
       break;
@@ -179,7 +187,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
       *cycles = 4;
       break;
     case 0x46:  // LD B, (HL)
-      B = ram[HL];
+      B = Read8(cpu, HL);
       DEBUG_PRINT("[INSTR] LD B, (HL)\n");
       ++*pc;
       *cycles = 8;
@@ -222,7 +230,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
       *cycles = 4;
       break;
     case 0x4E:  // LD C, (HL)
-      C = ram[HL];
+      C = Read8(cpu, HL);
       DEBUG_PRINT("[INSTR] LD C, (HL)\n");
       ++*pc;
       *cycles = 8;
@@ -265,7 +273,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
       *cycles = 4;
       break;
     case 0x56:  // LD D, (HL)
-      D = ram[HL];
+      D = Read8(cpu, HL);
       DEBUG_PRINT("[INSTR] LD D, (HL)\n");
       ++*pc;
       *cycles = 8;
@@ -308,7 +316,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
       *cycles = 4;
       break;
     case 0x5E:  // LD E, (HL)
-      E = ram[HL];
+      E = Read8(cpu, HL);
       DEBUG_PRINT("[INSTR] LD E, (HL)\n");
       ++*pc;
       *cycles = 8;
@@ -351,7 +359,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
       *cycles = 4;
       break;
     case 0x66:  // LD H, (HL)
-      H = ram[HL];
+      H = Read8(cpu, HL);
       DEBUG_PRINT("[INSTR] LD H, (HL)\n");
       ++*pc;
       *cycles = 8;
@@ -394,51 +402,51 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
       *cycles = 4;
       break;
     case 0x6E:  // LD L, (HL)
-      L = ram[HL];
+      L = Read8(cpu, HL);
       DEBUG_PRINT("[INSTR] LD L, (HL)\n");
       ++*pc;
       *cycles = 8;
       break;
 
     case 0x70:  // LD (HL), B
-      ram[HL] = B;
+      Write8(cpu, HL, B);
       DEBUG_PRINT("[INSTR] LD (HL), B\n");
       ++*pc;
       *cycles = 8;
       break;
     case 0x71:  // LD (HL), C
-      ram[HL] = C;
+      Write8(cpu, HL, C);
       DEBUG_PRINT("[INSTR] LD (HL), C\n");
       ++*pc;
       *cycles = 8;
       break;
     case 0x72:  // LD (HL), D
-      ram[HL] = D;
+      Write8(cpu, HL, D);
       DEBUG_PRINT("[INSTR] LD (HL), D\n");
       ++*pc;
       *cycles = 8;
       break;
     case 0x73:  // LD (HL), E
-      ram[HL] = E;
+      Write8(cpu, HL, E);
       DEBUG_PRINT("[INSTR] LD (HL), E\n");
       ++*pc;
       *cycles = 8;
       break;
     case 0x74:  // LD (HL), H
-      ram[HL] = H;
+      Write8(cpu, HL, H);
       DEBUG_PRINT("[INSTR] LD (HL), H\n");
       ++*pc;
       *cycles = 8;
       break;
     case 0x75:  // LD (HL), L
-      ram[HL] = L;
+      Write8(cpu, HL, L);
       DEBUG_PRINT("[INSTR] LD (HL), L\n");
       ++*pc;
       *cycles = 8;
       break;
     case 0x36:  // LD (HL), u8
-      ram[HL] = ram[++*pc];
-      DEBUG_PRINT("[INSTR] LD (HL), $%02X\n", ram[*pc]);
+      Write8(cpu, HL, Read8(cpu, ++*pc));
+      DEBUG_PRINT("[INSTR] LD (HL), $%02X\n", Read8(cpu, *pc));
       ++*pc;
       *cycles = 12;
       break;
@@ -480,28 +488,28 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
       *cycles = 4;
       break;
     case 0x02:  // LD (BC), A
-      ram[BC] = A;
+      Write8(cpu, BC, A);
       DEBUG_PRINT("[INSTR] LD (BC), A\n");
       ++*pc;
       *cycles = 8;
       break;
     case 0x12:  // LD (DE), A
-      ram[DE] = A;
+      Write8(cpu, DE, A);
       DEBUG_PRINT("[INSTR] LD (DE), A\n");
       ++*pc;
       *cycles = 8;
       break;
     case 0x77:  // LD (HL), A
-      ram[HL] = A;
+      Write8(cpu, HL, A);
       DEBUG_PRINT("[INSTR] LD (HL), A\n");
       ++*pc;
       *cycles = 8;
       break;
     case 0xEA:  // LD (u16), A
     {
-      uint16_t u16 = ram[*pc + 1] | ram[*pc + 2] << 010;
+      uint16_t u16 = Read8(cpu, *pc + 1) | Read8(cpu, *pc + 2) << 010;
       *pc += 2;
-      ram[u16] = A;
+      Write8(cpu, u16, A);
       DEBUG_PRINT("[INSTR] LD ($%04X), A\n", u16);
       ++*pc;
       *cycles = 16;
@@ -509,13 +517,13 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
     }
 
     case 0xF2:  // LD A, (FF00 + C)
-      A = ram[0xFF00 + C];
+      A = Read8(cpu, 0xFF00 + C);
       DEBUG_PRINT("[INSTR] LD A, (FF00 + C)\n");
       ++*pc;
       *cycles = 8;
       break;
     case 0xE2:  // LD (FF00 + C), A
-      ram[0xFF00 + C] = A;
+      Write8(cpu, 0xFF00 + C, A);
       DEBUG_PRINT("[INSTR] LD (FF00 + C), A\n");
       ++*pc;
       *cycles = 8;
@@ -523,7 +531,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
 
     case 0x3A:  // LD A, (HL-)
     {
-      A = ram[HL];
+      A = Read8(cpu, HL);
       uint16_t u16 = HL - 1;
       H = u16 >> 010;
       L = u16 & 0xFF;
@@ -534,7 +542,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
     }
     case 0x32:  // LD (HL-), A
     {
-      ram[HL] = A;
+      Write8(cpu, HL, A);
       uint16_t u16 = HL - 1;
       H = u16 >> 010;
       L = u16 & 0xFF;
@@ -546,7 +554,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
 
     case 0x2A:  // LD A, (HL+)
     {
-      A = ram[HL];
+      A = Read8(cpu, HL);
       uint16_t u16 = HL + 1;
       H = u16 >> 010;
       L = u16 & 0xFF;
@@ -557,7 +565,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
     }
     case 0x22:  // LD (HL+), A
     {
-      ram[HL] = A;
+      Write8(cpu, HL, A);
       uint16_t u16 = HL + 1;
       H = u16 >> 010;
       L = u16 & 0xFF;
@@ -568,14 +576,14 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
     }
 
     case 0xF0:  // LD A, (FF00 + u8)
-      A = ram[0xFF00 + ram[++*pc]];
-      DEBUG_PRINT("[INSTR] LD A, (FF00 + $%02X)\n", ram[*pc]);
+      A = Read8(cpu, 0xFF00 + Read8(cpu, ++*pc));
+      DEBUG_PRINT("[INSTR] LD A, (FF00 + $%02X)\n", Read8(cpu, *pc));
       ++*pc;
       *cycles = 12;
       break;
     case 0xE0:  // LD (FF00 + u8), A
-      ram[0xFF00 + ram[++*pc]] = A;
-      DEBUG_PRINT("[INSTR] LD (FF00 + $%02X), A\n", ram[*pc]);
+      Write8(cpu, 0xFF00 + Read8(cpu, ++*pc), A);
+      DEBUG_PRINT("[INSTR] LD (FF00 + $%02X), A\n", Read8(cpu, *pc));
       ++*pc;
       *cycles = 12;
       break;
@@ -584,28 +592,28 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
      *  16-Bit Loads
      *--------------*/
     case 0x01:  // LD BC, u16
-      C = ram[++*pc];
-      B = ram[++*pc];
+      C = Read8(cpu, ++*pc);
+      B = Read8(cpu, ++*pc);
       DEBUG_PRINT("[INSTR] LD BC, $%04X\n", BC);
       ++*pc;
       *cycles = 12;
       break;
     case 0x11:  // LD DE, u16
-      E = ram[++*pc];
-      D = ram[++*pc];
+      E = Read8(cpu, ++*pc);
+      D = Read8(cpu, ++*pc);
       DEBUG_PRINT("[INSTR] LD DE, $%04X\n", DE);
       ++*pc;
       *cycles = 12;
       break;
     case 0x21:  // LD HL, u16
-      L = ram[++*pc];
-      H = ram[++*pc];
+      L = Read8(cpu, ++*pc);
+      H = Read8(cpu, ++*pc);
       DEBUG_PRINT("[INSTR] LD HL, $%04X\n", HL);
       ++*pc;
       *cycles = 12;
       break;
     case 0x31:  // LD SP, u16
-      *sp = ram[*pc + 1] | ram[*pc + 2] << 010;
+      *sp = Read8(cpu, *pc + 1) | Read8(cpu, *pc + 2) << 010;
       *pc += 2;
       DEBUG_PRINT("[INSTR] LD SP, $%04X\n", *sp);
       ++*pc;
@@ -623,7 +631,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
     {
       RES_Z;
       RES_N;
-      int8_t i8 = (int8_t)ram[++*pc];
+      int8_t i8 = (int8_t)Read8(cpu, ++*pc);
       IF_H(HALFCARRY_16(*sp, i8));
       IF_C(CARRY_16(*sp, i8));
       uint16_t u16 = *sp + i8;
@@ -636,67 +644,67 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
     }
 
     case 0x08:  // LD (u16), HL
-      ram[ram[++*pc]] = L;
-      ram[ram[++*pc]] = H;
-      DEBUG_PRINT("[INSTR] LD ($%04X), HL\n", *((uint16_t *)ram - 2));
+      Write8(cpu, Read8(cpu, ++*pc), L);
+      Write8(cpu, Read8(cpu, ++*pc), H);
+      DEBUG_PRINT("[INSTR] LD ($%02X), HL\n", Read8(cpu, *pc - 1));
       ++*pc;
       *cycles = 20;
       break;
 
     case 0xF5:  //  PUSH AF
-      ram[--*sp] = A;
-      ram[--*sp] = F;
+      Write8(cpu, --*sp, A);
+      Write8(cpu, --*sp, F);
       DEBUG_PRINT("[INSTR] PUSH AF\n");
       ++*pc;
       *cycles = 16;
       break;
     case 0xC5:  //  PUSH BC
-      ram[--*sp] = B;
-      ram[--*sp] = C;
+      Write8(cpu, --*sp, B);
+      Write8(cpu, --*sp, C);
       DEBUG_PRINT("[INSTR] PUSH BC\n");
       ++*pc;
       *cycles = 16;
       break;
     case 0xD5:  //  PUSH DE
-      ram[--*sp] = D;
-      ram[--*sp] = E;
+      Write8(cpu, --*sp, D);
+      Write8(cpu, --*sp, E);
       DEBUG_PRINT("[INSTR] PUSH DE\n");
       ++*pc;
       *cycles = 16;
       break;
     case 0xE5:  //  PUSH HL
-      ram[--*sp] = H;
-      ram[--*sp] = L;
+      Write8(cpu, --*sp, H);
+      Write8(cpu, --*sp, L);
       DEBUG_PRINT("[INSTR] PUSH HL\n");
       ++*pc;
       *cycles = 16;
       break;
 
     case 0xF1:  //  POP AF
-      F = ram[(*sp)++];
+      F = Read8(cpu, (*sp)++);
       F &= 0xF0;
-      A = ram[(*sp)++];
+      A = Read8(cpu, (*sp)++);
       DEBUG_PRINT("[INSTR] POP AF\n");
       ++*pc;
       *cycles = 12;
       break;
     case 0xC1:  //  POP BC
-      C = ram[(*sp)++];
-      B = ram[(*sp)++];
+      C = Read8(cpu, (*sp)++);
+      B = Read8(cpu, (*sp)++);
       DEBUG_PRINT("[INSTR] POP BC\n");
       ++*pc;
       *cycles = 12;
       break;
     case 0xD1:  //  POP DE
-      E = ram[(*sp)++];
-      D = ram[(*sp)++];
+      E = Read8(cpu, (*sp)++);
+      D = Read8(cpu, (*sp)++);
       DEBUG_PRINT("[INSTR] POP DE\n");
       ++*pc;
       *cycles = 12;
       break;
     case 0xE1:  //  POP HL
-      L = ram[(*sp)++];
-      H = ram[(*sp)++];
+      L = Read8(cpu, (*sp)++);
+      H = Read8(cpu, (*sp)++);
       DEBUG_PRINT("[INSTR] POP HL\n");
       ++*pc;
       *cycles = 12;
@@ -792,7 +800,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
     case 0x86:  //  ADD A, (HL)
     {
       RES_N;
-      uint8_t u8 = ram[HL];
+      uint8_t u8 = Read8(cpu, HL);
       IF_H(HALFCARRY_8(A, u8));
       IF_C(CARRY_8(A, u8));
       A += u8;
@@ -805,7 +813,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
     case 0xC6:  //  ADD A, u8
     {
       RES_N;
-      uint8_t u8 = ram[++*pc];
+      uint8_t u8 = Read8(cpu, ++*pc);
       A += u8;
       IF_Z(!A);
       IF_H(HALFCARRY_8(A, u8));
@@ -903,7 +911,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
     case 0x8E:  //  ADC A, (HL)
     {
       RES_N;
-      uint8_t u8 = ram[HL] + GET_C;
+      uint8_t u8 = Read8(cpu, HL) + GET_C;
       IF_H(HALFCARRY_8(A, u8));
       IF_C(CARRY_8(A, u8));
       A += u8;
@@ -916,7 +924,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
     case 0xCE:  //  ADC A, u8
     {
       RES_N;
-      uint8_t u8 = ram[++*pc] + GET_C;
+      uint8_t u8 = Read8(cpu, ++*pc) + GET_C;
       A += u8;
       IF_Z(!A);
       IF_H(HALFCARRY_8(A, u8));
@@ -1014,7 +1022,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
     case 0x96:  //  SUB A, (HL)
     {
       SET_N;
-      uint8_t u8 = ram[HL];
+      uint8_t u8 = Read8(cpu, HL);
       IF_H(HALFCARRY_8(A, ~(u8 + 1)));
       IF_C(CARRY_8(A, ~(u8 + 1)));
       A -= u8;
@@ -1027,7 +1035,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
     case 0xD6:  //  SUB A, u8
     {
       SET_N;
-      uint8_t u8 = ram[++*pc];
+      uint8_t u8 = Read8(cpu, ++*pc);
       A -= u8;
       IF_Z(!A);
       IF_H(HALFCARRY_8(A, ~(u8 + 1)));
@@ -1125,7 +1133,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
     case 0x9E:  //  SBC A, (HL)
     {
       SET_N;
-      uint8_t u8 = ram[HL] + GET_C;
+      uint8_t u8 = Read8(cpu, HL) + GET_C;
       IF_H(HALFCARRY_8(A, ~(u8 + 1)));
       IF_C(CARRY_8(A, ~(u8 + 1)));
       A -= u8;
@@ -1138,7 +1146,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
     case 0xDE:  //  SBC A, u8
     {
       SET_N;
-      uint8_t u8 = ram[++*pc] + GET_C;
+      uint8_t u8 = Read8(cpu, ++*pc) + GET_C;
       A -= u8;
       IF_Z(!A);
       IF_H(HALFCARRY_8(A, ~(u8 + 1)));
@@ -1223,7 +1231,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
       RES_N;
       SET_H;
       RES_C;
-      A &= ram[HL];
+      A &= Read8(cpu, HL);
       IF_Z(!A);
       DEBUG_PRINT("[INSTR] AND A, (HL)\n");
       ++*pc;
@@ -1233,9 +1241,9 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
       RES_N;
       SET_H;
       RES_C;
-      A &= ram[++*pc];
+      A &= Read8(cpu, ++*pc);
       IF_Z(!A);
-      DEBUG_PRINT("[INSTR] AND A, $%02X\n", ram[*pc]);
+      DEBUG_PRINT("[INSTR] AND A, $%02X\n", Read8(cpu, *pc));
       ++*pc;
       *cycles = 8;
       break;
@@ -1314,7 +1322,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
       RES_N;
       RES_H;
       RES_C;
-      A |= ram[HL];
+      A |= Read8(cpu, HL);
       IF_Z(!A);
       DEBUG_PRINT("[INSTR] OR A, (HL)\n");
       ++*pc;
@@ -1324,9 +1332,9 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
       RES_N;
       RES_H;
       RES_C;
-      A |= ram[++*pc];
+      A |= Read8(cpu, ++*pc);
       IF_Z(!A);
-      DEBUG_PRINT("[INSTR] OR A, $%02X\n", ram[*pc]);
+      DEBUG_PRINT("[INSTR] OR A, $%02X\n", Read8(cpu, *pc));
       ++*pc;
       *cycles = 8;
       break;
@@ -1405,7 +1413,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
       RES_N;
       RES_H;
       RES_C;
-      A ^= ram[HL];
+      A ^= Read8(cpu, HL);
       IF_Z(!A);
       DEBUG_PRINT("[INSTR] XOR A, (HL)\n");
       ++*pc;
@@ -1415,9 +1423,9 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
       RES_N;
       RES_H;
       RES_C;
-      A ^= ram[++*pc];
+      A ^= Read8(cpu, ++*pc);
       IF_Z(!A);
-      DEBUG_PRINT("[INSTR] XOR A, $%02X\n", ram[*pc]);
+      DEBUG_PRINT("[INSTR] XOR A, $%02X\n", Read8(cpu, *pc));
       ++*pc;
       *cycles = 8;
       break;
@@ -1487,9 +1495,9 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
       break;
     case 0xBE:  // CP A, (HL)
       SET_N;
-      IF_Z(A == ram[HL]);
-      IF_H(HALFCARRY_8(A, (~ram[HL] + 1)));
-      IF_C(A < ram[HL]);
+      IF_Z(A == Read8(cpu, HL));
+      IF_H(HALFCARRY_8(A, (~Read8(cpu, HL) + 1)));
+      IF_C(A < Read8(cpu, HL));
       DEBUG_PRINT("[INSTR] CP A, (HL)\n");
       ++*pc;
       *cycles = 8;
@@ -1497,7 +1505,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
     case 0xFE:  // CP A, u8
     {
       SET_N;
-      uint8_t u8 = ram[++*pc];
+      uint8_t u8 = Read8(cpu, ++*pc);
       IF_Z(A == u8);
       IF_H(HALFCARRY_8(A, (~u8 + 1)));
       IF_C(A < u8);
@@ -1587,9 +1595,9 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
     case 0x34:  //  INC (HL)
     {
       RES_N;
-      ram[HL]++;
-      IF_Z(!ram[HL]);
-      IF_H(HALFCARRY_8(ram[HL], 1));
+      Write8(cpu, HL, Read8(cpu, HL) + 1);
+      IF_Z(!Read8(cpu, HL));
+      IF_H(HALFCARRY_8(Read8(cpu, HL), 1));
       DEBUG_PRINT("[INSTR] INC (HL)\n");
       ++*pc;
       *cycles = 12;
@@ -1676,9 +1684,9 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
     case 0x35:  //  DEC (HL)
     {
       SET_N;
-      ram[HL]--;
-      IF_Z(!ram[HL]);
-      IF_H(HALFCARRY_8(ram[HL], 0xFF));
+      Write8(cpu, HL, Read8(cpu, HL) - 1);
+      IF_Z(!Read8(cpu, HL));
+      IF_H(HALFCARRY_8(Read8(cpu, HL), 0xFF));
       DEBUG_PRINT("[INSTR] DEC (HL)\n");
       ++*pc;
       *cycles = 12;
@@ -1744,7 +1752,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
     case 0xE8:  // ADD SP, i8
       RES_Z;
       RES_N;
-      int8_t i8 = ram[++*pc];
+      int8_t i8 = Read8(cpu, ++*pc);
       IF_H(HALFCARRY_16(*sp, i8));
       IF_C(CARRY_16(*sp, i8));
       *sp += i8;
@@ -1832,7 +1840,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
      *------*/
     case 0x27:  //  DAA
     {
-      dbg.trace = DBG_STEP;
+      dbg->trace = DBG_STEP;
       int8_t correction = A;
 
       if (!GET_N) {
@@ -1885,28 +1893,30 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
       break;
 
     case 0x76:  // HALT
-      *hlt = true;
-      printf("[INFO] HALT\n");
+      *hlt = cpu->yield = true;
+      DEBUG_PRINT("[INSTR] HALT\n");
       ++*pc;
       *cycles = 4;
       break;
 
     case 0x10:  // STOP
-      *hlt = true;
-      printf("[INFO] STOP\n");
-      CoreDump("core-GameboyEmulator.dmp", ram);
+      *hlt = cpu->yield = true;
+      cpu->io = DIV;
+      DEBUG_PRINT("[INSTR] STOP\n");
       *pc += 2;  //??
       *cycles = 4;
       break;
 
     case 0xF3:  // DI
       *IME = false;
+      cpu->irq = false;
       DEBUG_PRINT("[INSTR] DI\n");
       ++*pc;
       *cycles = 4;
       break;
 
     case 0xFB:  // EI
+      if (!*IME) cpu->ei = cpu->yield = true;
       *IME = true;
       DEBUG_PRINT("[INSTR] EI\n");
       ++*pc;
@@ -1967,41 +1977,45 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
      *  Jumps
      *-------*/
     case 0xC3:  // JP u16
-      *pc = ram[*pc + 1] | ram[*pc + 2] << 010;
+      *pc = Read8(cpu, *pc + 1) | Read8(cpu, *pc + 2) << 010;
       DEBUG_PRINT("[INSTR] JP $%04X\n", *pc);
       *cycles = 16;
       break;
 
     case 0xC2:  // JP NZ, u16
       if (!GET_Z)
-        *pc = ram[*pc + 1] | ram[*pc + 2] << 010;
+        *pc = Read8(cpu, *pc + 1) | Read8(cpu, *pc + 2) << 010;
       else
         *pc += 3;
-      DEBUG_PRINT("[INSTR] JP NZ, $%04X\n", ram[*pc] | ram[*pc + 1] << 010);
+      DEBUG_PRINT("[INSTR] JP NZ, $%04X\n",
+                  Read8(cpu, *pc) | Read8(cpu, *pc + 1) << 010);
       *cycles = 12;
       break;
     case 0xCA:  // JP Z, u16
       if (GET_Z)
-        *pc = ram[*pc + 1] | ram[*pc + 2] << 010;
+        *pc = Read8(cpu, *pc + 1) | Read8(cpu, *pc + 2) << 010;
       else
         *pc += 3;
-      DEBUG_PRINT("[INSTR] JP Z, $%04X\n", ram[*pc] | ram[*pc + 1] << 010);
+      DEBUG_PRINT("[INSTR] JP Z, $%04X\n",
+                  Read8(cpu, *pc) | Read8(cpu, *pc + 1) << 010);
       *cycles = 12;
       break;
     case 0xD2:  // JP NC, u16
       if (!GET_C)
-        *pc = ram[*pc + 1] | ram[*pc + 2] << 010;
+        *pc = Read8(cpu, *pc + 1) | Read8(cpu, *pc + 2) << 010;
       else
         *pc += 3;
-      DEBUG_PRINT("[INSTR] JP NC, $%04X\n", ram[*pc] | ram[*pc + 1] << 010);
+      DEBUG_PRINT("[INSTR] JP NC, $%04X\n",
+                  Read8(cpu, *pc) | Read8(cpu, *pc + 1) << 010);
       *cycles = 12;
       break;
     case 0xDA:  // JP C, u16
       if (GET_C)
-        *pc = ram[*pc + 1] | ram[*pc + 2] << 010;
+        *pc = Read8(cpu, *pc + 1) | Read8(cpu, *pc + 2) << 010;
       else
         *pc += 3;
-      DEBUG_PRINT("[INSTR] JP C, $%04X\n", ram[*pc] | ram[*pc + 1] << 010);
+      DEBUG_PRINT("[INSTR] JP C, $%04X\n",
+                  Read8(cpu, *pc) | Read8(cpu, *pc + 1) << 010);
       *cycles = 12;
       break;
 
@@ -2013,7 +2027,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
 
     case 0x18:  // JR i8
     {
-      int8_t i8 = ram[++*pc];
+      int8_t i8 = Read8(cpu, ++*pc);
       *pc += i8;
       ++*pc;
       DEBUG_PRINT("[INSTR] JR $%04X\n", *pc);
@@ -2023,7 +2037,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
 
     case 0x20:  // JR NZ, i8
     {
-      int8_t i8 = ram[++*pc];
+      int8_t i8 = Read8(cpu, ++*pc);
       uint16_t addr = *pc + i8;
       if (!GET_Z) *pc = addr;
       ++*pc;
@@ -2033,7 +2047,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
     }
     case 0x28:  // JR Z, i8
     {
-      int8_t i8 = ram[++*pc];
+      int8_t i8 = Read8(cpu, ++*pc);
       uint16_t addr = *pc + i8;
       if (GET_Z) *pc = addr;
       ++*pc;
@@ -2043,7 +2057,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
     }
     case 0x30:  // JR NC, i8
     {
-      int8_t i8 = ram[++*pc];
+      int8_t i8 = Read8(cpu, ++*pc);
       uint16_t addr = *pc + i8;
       if (!GET_C) *pc = addr;
       ++*pc;
@@ -2053,7 +2067,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
     }
     case 0x38:  // JR C, i8
     {
-      int8_t i8 = ram[++*pc];
+      int8_t i8 = Read8(cpu, ++*pc);
       uint16_t addr = *pc + i8;
       if (GET_C) *pc = addr;
       ++*pc;
@@ -2067,10 +2081,10 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
        *-------*/
     case 0xCD:  // CALL u16
     {
-      uint16_t address = ram[*pc + 1] | ram[*pc + 2] << 010;
+      uint16_t address = Read8(cpu, *pc + 1) | Read8(cpu, *pc + 2) << 010;
       *pc += 3;
-      ram[--*sp] = *pc >> 010;
-      ram[--*sp] = *pc & 0xFF;
+      Write8(cpu, --*sp, *pc >> 010);
+      Write8(cpu, --*sp, *pc & 0xFF);
       *pc = address;
       DEBUG_PRINT("[INSTR] CALL $%04X\n", address);
       *cycles = 12;
@@ -2080,11 +2094,11 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
     case 0xC4:  // CALL NZ, u16
     {
       // op
-      uint16_t address = ram[*pc + 1] | ram[*pc + 2] << 010;
+      uint16_t address = Read8(cpu, *pc + 1) | Read8(cpu, *pc + 2) << 010;
       *pc += 3;
       if (!GET_Z) {
-        ram[--*sp] = *pc >> 010;
-        ram[--*sp] = *pc & 0xFF;
+        Write8(cpu, --*sp, *pc >> 010);
+        Write8(cpu, --*sp, *pc & 0xFF);
         *pc = address;
       }
       DEBUG_PRINT("[INSTR] CALL NZ, $%04X\n", address);
@@ -2094,11 +2108,11 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
     case 0xCC:  // CALL Z, u16
     {
       // op
-      uint16_t address = ram[*pc + 1] | ram[*pc + 2] << 010;
+      uint16_t address = Read8(cpu, *pc + 1) | Read8(cpu, *pc + 2) << 010;
       *pc += 3;
       if (GET_Z) {
-        ram[--*sp] = *pc >> 010;
-        ram[--*sp] = *pc & 0xFF;
+        Write8(cpu, --*sp, *pc >> 010);
+        Write8(cpu, --*sp, *pc & 0xFF);
         *pc = address;
       }
       DEBUG_PRINT("[INSTR] CALL Z, $%04X\n", address);
@@ -2108,11 +2122,11 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
     case 0xD4:  // CALL NC, u16
     {
       // op
-      uint16_t address = ram[*pc + 1] | ram[*pc + 2] << 010;
+      uint16_t address = Read8(cpu, *pc + 1) | Read8(cpu, *pc + 2) << 010;
       *pc += 3;
       if (!GET_C) {
-        ram[--*sp] = *pc >> 010;
-        ram[--*sp] = *pc & 0xFF;
+        Write8(cpu, --*sp, *pc >> 010);
+        Write8(cpu, --*sp, *pc & 0xFF);
         *pc = address;
       }
       DEBUG_PRINT("[INSTR] CALL NC, $%04X\n", address);
@@ -2122,11 +2136,11 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
     case 0xDC:  // CALL C, u16
     {
       // op
-      uint16_t address = ram[*pc + 1] | ram[*pc + 2] << 010;
+      uint16_t address = Read8(cpu, *pc + 1) | Read8(cpu, *pc + 2) << 010;
       *pc += 3;
       if (GET_C) {
-        ram[--*sp] = *pc >> 010;
-        ram[--*sp] = *pc & 0xFF;
+        Write8(cpu, --*sp, *pc >> 010);
+        Write8(cpu, --*sp, *pc & 0xFF);
         *pc = address;
       }
       DEBUG_PRINT("[INSTR] CALL C, $%04X\n", address);
@@ -2138,57 +2152,57 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
        *  Restarts
        *----------*/
     case 0xC7:  // RST 00h
-      ram[--*sp] = *pc >> 010;
-      ram[--*sp] = *pc & 0xFF;
+      Write8(cpu, --*sp, *pc >> 010);
+      Write8(cpu, --*sp, *pc & 0xFF);
       *pc = 0x00;
       DEBUG_PRINT("[INSTR] RST 00h\n");
       *cycles = 32;
       break;
     case 0xCF:  // RST 08h
-      ram[--*sp] = *pc >> 010;
-      ram[--*sp] = *pc & 0xFF;
+      Write8(cpu, --*sp, *pc >> 010);
+      Write8(cpu, --*sp, *pc & 0xFF);
       *pc = 0x08;
       DEBUG_PRINT("[INSTR] RST 08h\n");
       *cycles = 32;
       break;
     case 0xD7:  // RST 10h
-      ram[--*sp] = *pc >> 010;
-      ram[--*sp] = *pc & 0xFF;
+      Write8(cpu, --*sp, *pc >> 010);
+      Write8(cpu, --*sp, *pc & 0xFF);
       *pc = 0x10;
       DEBUG_PRINT("[INSTR] RST 10h\n");
       *cycles = 32;
       break;
     case 0xDF:  // RST 18h
-      ram[--*sp] = *pc >> 010;
-      ram[--*sp] = *pc & 0xFF;
+      Write8(cpu, --*sp, *pc >> 010);
+      Write8(cpu, --*sp, *pc & 0xFF);
       *pc = 0x18;
       DEBUG_PRINT("[INSTR] RST 18h\n");
       *cycles = 32;
       break;
     case 0xE7:  // RST 20h
-      ram[--*sp] = *pc >> 010;
-      ram[--*sp] = *pc & 0xFF;
+      Write8(cpu, --*sp, *pc >> 010);
+      Write8(cpu, --*sp, *pc & 0xFF);
       *pc = 0x20;
       DEBUG_PRINT("[INSTR] RST 20h\n");
       *cycles = 32;
       break;
     case 0xEF:  // RST 28h
-      ram[--*sp] = *pc >> 010;
-      ram[--*sp] = *pc & 0xFF;
+      Write8(cpu, --*sp, *pc >> 010);
+      Write8(cpu, --*sp, *pc & 0xFF);
       *pc = 0x28;
       DEBUG_PRINT("[INSTR] RST 28h\n");
       *cycles = 32;
       break;
     case 0xF7:  // RST 30h
-      ram[--*sp] = *pc >> 010;
-      ram[--*sp] = *pc & 0xFF;
+      Write8(cpu, --*sp, *pc >> 010);
+      Write8(cpu, --*sp, *pc & 0xFF);
       *pc = 0x30;
       DEBUG_PRINT("[INSTR] RST 30h\n");
       *cycles = 32;
       break;
     case 0xFF:  // RST 38h
-      ram[--*sp] = *pc >> 010;
-      ram[--*sp] = *pc & 0xFF;
+      Write8(cpu, --*sp, *pc >> 010);
+      Write8(cpu, --*sp, *pc & 0xFF);
       *pc = 0x38;
       DEBUG_PRINT("[INSTR] RST 38h\n");
       *cycles = 32;
@@ -2198,7 +2212,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
        *  Returns
        *--------*/
     case 0xC9:  // RET
-      *pc = ram[*sp] | ram[*sp + 1] << 010;
+      *pc = Read8(cpu, *sp) | Read8(cpu, *sp + 1) << 010;
       *sp += 2;
       DEBUG_PRINT("[INSTR] RET\n");
       *cycles = 8;
@@ -2206,7 +2220,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
 
     case 0xC0:  // RET NZ
       if (!GET_Z) {
-        *pc = ram[*sp] | ram[*sp + 1] << 010;
+        *pc = Read8(cpu, *sp) | Read8(cpu, *sp + 1) << 010;
         *sp += 2;
       } else
         ++*pc;
@@ -2215,7 +2229,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
       break;
     case 0xC8:  // RET Z
       if (GET_Z) {
-        *pc = ram[*sp] | ram[*sp + 1] << 010;
+        *pc = Read8(cpu, *sp) | Read8(cpu, *sp + 1) << 010;
         *sp += 2;
       } else
         ++*pc;
@@ -2224,7 +2238,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
       break;
     case 0xD0:  // RET NC
       if (!GET_C) {
-        *pc = ram[*sp] | ram[*sp + 1] << 010;
+        *pc = Read8(cpu, *sp) | Read8(cpu, *sp + 1) << 010;
         *sp += 2;
       } else
         ++*pc;
@@ -2233,7 +2247,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
       break;
     case 0xD8:  // RET C
       if (GET_C) {
-        *pc = ram[*sp] | ram[*sp + 1] << 010;
+        *pc = Read8(cpu, *sp) | Read8(cpu, *sp + 1) << 010;
         *sp += 2;
       } else
         ++*pc;
@@ -2242,9 +2256,10 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
       break;
 
     case 0xD9:  // RETI
-      *pc = ram[*sp] | ram[*sp + 1] << 010;
+      *pc = Read8(cpu, *sp) | Read8(cpu, *sp + 1) << 010;
       *sp += 2;
       *IME = true;
+      cpu->yield = true;
       DEBUG_PRINT("[INSTR] RETI\n");
       *cycles = 8;
       break;
@@ -2253,7 +2268,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
      *  Prefix for extended instructions
      *----------------------------------*/
     case 0XCB:
-      opcode = ram[++*pc];
+      opcode = Read8(cpu, ++*pc);
       switch (opcode) {
           /*------
            *  Misc
@@ -2361,10 +2376,10 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
           RES_H;
           RES_C;
           RES_Z;
-          if (!ram[HL]) {
+          if (!Read8(cpu, HL)) {
             SET_Z;
           } else {
-            ram[HL] = (ram[HL] >> 4) | (ram[HL] << 4);
+            Write8(cpu, HL, (Read8(cpu, HL) >> 4) | (Read8(cpu, HL) << 4));
           }
           DEBUG_PRINT("[INSTR] SWAP L\n");
           ++*pc;
@@ -2448,9 +2463,9 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
         case 0x06:  // RLC (HL)
           RES_N;
           RES_H;
-          IF_C((ram[HL] & 0x80) != 0);
-          ram[HL] = (ram[HL] << 1) | GET_C;
-          IF_Z(!ram[HL]);
+          IF_C((Read8(cpu, HL) & 0x80) != 0);
+          Write8(cpu, HL, (Read8(cpu, HL) << 1) | GET_C);
+          IF_Z(!Read8(cpu, HL));
           DEBUG_PRINT("[INSTR] RLC (HL)\n");
           ++*pc;
           *cycles = 16;
@@ -2552,9 +2567,9 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
           RES_N;
           RES_H;
           uint8_t carry = GET_C;
-          IF_C((ram[HL] & 0x80) != 0);
-          ram[HL] = ram[HL] << 1 | carry;
-          IF_Z(!ram[HL]);
+          IF_C((Read8(cpu, HL) & 0x80) != 0);
+          Write8(cpu, HL, Read8(cpu, HL) << 1 | carry);
+          IF_Z(!Read8(cpu, HL));
           DEBUG_PRINT("[INSTR] RL (HL)\n");
           ++*pc;
           *cycles = 16;
@@ -2634,9 +2649,9 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
         case 0x0E:  // RRC (HL)
           RES_N;
           RES_H;
-          IF_C((ram[HL] & 0x01) != 0);
-          ram[HL] = (ram[HL] >> 1) | GET_C << 7;
-          IF_Z(!ram[HL]);
+          IF_C((Read8(cpu, HL) & 0x01) != 0);
+          Write8(cpu, HL, (Read8(cpu, HL) >> 1) | GET_C << 7);
+          IF_Z(!Read8(cpu, HL));
           DEBUG_PRINT("[INSTR] RRC (HL)\n");
           ++*pc;
           *cycles = 16;
@@ -2738,9 +2753,9 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
           RES_N;
           RES_H;
           uint8_t carry = GET_C << 7;
-          IF_C((ram[HL] & 0x01) != 0);
-          ram[HL] = ram[HL] >> 1 | carry;
-          IF_Z(!ram[HL]);
+          IF_C((Read8(cpu, HL) & 0x01) != 0);
+          Write8(cpu, HL, Read8(cpu, HL) >> 1 | carry);
+          IF_Z(!Read8(cpu, HL));
           DEBUG_PRINT("[INSTR] RR (HL)\n");
           ++*pc;
           *cycles = 16;
@@ -2835,9 +2850,9 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
         {
           RES_N;
           RES_H;
-          IF_C((ram[HL] & 0x80) == 0x80);
-          ram[HL] = ram[HL] << 1;
-          IF_Z(!ram[HL]);
+          IF_C((Read8(cpu, HL) & 0x80) == 0x80);
+          Write8(cpu, HL, Read8(cpu, HL) << 1);
+          IF_Z(!Read8(cpu, HL));
           DEBUG_PRINT("[INSTR] SLA (HL)\n");
           ++*pc;
           *cycles = 16;
@@ -2939,10 +2954,10 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
         {
           RES_N;
           RES_H;
-          IF_C((ram[HL] & 1) == 1);
-          uint8_t msb = ram[HL] & 0x80;
-          ram[HL] = ram[HL] >> 1 | msb;
-          IF_Z(!ram[HL]);
+          IF_C((Read8(cpu, HL) & 1) == 1);
+          uint8_t msb = Read8(cpu, HL) & 0x80;
+          Write8(cpu, HL, Read8(cpu, HL) >> 1 | msb);
+          IF_Z(!Read8(cpu, HL));
           DEBUG_PRINT("[INSTR] SRA (HL)\n");
           ++*pc;
           *cycles = 16;
@@ -3022,9 +3037,9 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
         case 0x3E:  //  SRL (HL)
           RES_N;
           RES_H;
-          IF_C((ram[HL] & 1) == 1);
-          ram[HL] = ram[HL] >> 1;
-          IF_Z(!ram[HL]);
+          IF_C((Read8(cpu, HL) & 1) == 1);
+          Write8(cpu, HL, Read8(cpu, HL) >> 1);
+          IF_Z(!Read8(cpu, HL));
           DEBUG_PRINT("[INSTR] SRL (HL)\n");
           ++*pc;
           *cycles = 16;
@@ -3092,7 +3107,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
         case 0x46:  // BIT 0, (HL)
           RES_N;
           SET_H;
-          IF_Z(!CHECK_BIT(0, ram[HL]));
+          IF_Z(!CHECK_BIT(0, Read8(cpu, HL)));
           DEBUG_PRINT("[INSTR] BIT 0, (HL)\n");
           ++*pc;
           *cycles = 16;
@@ -3156,7 +3171,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
         case 0x4E:  // BIT 1, (HL)
           RES_N;
           SET_H;
-          IF_Z(!CHECK_BIT(1, ram[HL]));
+          IF_Z(!CHECK_BIT(1, Read8(cpu, HL)));
           DEBUG_PRINT("[INSTR] BIT 1, (HL)\n");
           ++*pc;
           *cycles = 16;
@@ -3220,7 +3235,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
         case 0x56:  // BIT 2, (HL)
           RES_N;
           SET_H;
-          IF_Z(!CHECK_BIT(2, ram[HL]));
+          IF_Z(!CHECK_BIT(2, Read8(cpu, HL)));
           DEBUG_PRINT("[INSTR] BIT 2, (HL)\n");
           ++*pc;
           *cycles = 16;
@@ -3284,7 +3299,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
         case 0x5E:  // BIT 3, (HL)
           RES_N;
           SET_H;
-          IF_Z(!CHECK_BIT(3, ram[HL]));
+          IF_Z(!CHECK_BIT(3, Read8(cpu, HL)));
           DEBUG_PRINT("[INSTR] BIT 3, (HL)\n");
           ++*pc;
           *cycles = 16;
@@ -3348,7 +3363,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
         case 0x66:  // BIT 4, (HL)
           RES_N;
           SET_H;
-          IF_Z(!CHECK_BIT(4, ram[HL]));
+          IF_Z(!CHECK_BIT(4, Read8(cpu, HL)));
           DEBUG_PRINT("[INSTR] BIT 4, (HL)\n");
           ++*pc;
           *cycles = 16;
@@ -3412,7 +3427,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
         case 0x6E:  // BIT 5, (HL)
           RES_N;
           SET_H;
-          IF_Z(!CHECK_BIT(5, ram[HL]));
+          IF_Z(!CHECK_BIT(5, Read8(cpu, HL)));
           DEBUG_PRINT("[INSTR] BIT 5, (HL)\n");
           ++*pc;
           *cycles = 16;
@@ -3476,7 +3491,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
         case 0x76:  // BIT 6, (HL)
           RES_N;
           SET_H;
-          IF_Z(!CHECK_BIT(6, ram[HL]));
+          IF_Z(!CHECK_BIT(6, Read8(cpu, HL)));
           DEBUG_PRINT("[INSTR] BIT 6, (HL)\n");
           ++*pc;
           *cycles = 16;
@@ -3540,7 +3555,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
         case 0x7E:  // BIT 7, (HL)
           RES_N;
           SET_H;
-          IF_Z(!CHECK_BIT(7, ram[HL]));
+          IF_Z(!CHECK_BIT(7, Read8(cpu, HL)));
           DEBUG_PRINT("[INSTR] BIT 7, (HL)\n");
           ++*pc;
           *cycles = 16;
@@ -3589,7 +3604,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
           *cycles = 8;
           break;
         case 0xC6:  // SET 0, (HL)
-          SET_BIT(0, ram[HL]);
+          Write8(cpu, HL, Read8(cpu, HL) | 1 << 0);
           DEBUG_PRINT("[INSTR] SET 0, (HL)\n");
           ++*pc;
           *cycles = 16;
@@ -3637,7 +3652,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
           *cycles = 8;
           break;
         case 0xCE:  // SET 1, (HL)
-          SET_BIT(1, ram[HL]);
+          Write8(cpu, HL, Read8(cpu, HL) | 1 << 1);
           DEBUG_PRINT("[INSTR] SET 1, (HL)\n");
           ++*pc;
           *cycles = 16;
@@ -3685,7 +3700,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
           *cycles = 8;
           break;
         case 0xD6:  // SET 2, (HL)
-          SET_BIT(2, ram[HL]);
+          Write8(cpu, HL, Read8(cpu, HL) | 1 << 2);
           DEBUG_PRINT("[INSTR] SET 2, (HL)\n");
           ++*pc;
           *cycles = 16;
@@ -3733,7 +3748,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
           *cycles = 8;
           break;
         case 0xDE:  // SET 3, (HL)
-          SET_BIT(3, ram[HL]);
+          Write8(cpu, HL, Read8(cpu, HL) | 1 << 3);
           DEBUG_PRINT("[INSTR] SET 3, (HL)\n");
           ++*pc;
           *cycles = 16;
@@ -3781,7 +3796,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
           *cycles = 8;
           break;
         case 0xE6:  // SET 4, (HL)
-          SET_BIT(4, ram[HL]);
+          Write8(cpu, HL, Read8(cpu, HL) | 1 << 4);
           DEBUG_PRINT("[INSTR] SET 4, (HL)\n");
           ++*pc;
           *cycles = 16;
@@ -3829,7 +3844,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
           *cycles = 8;
           break;
         case 0xEE:  // SET 5, (HL)
-          SET_BIT(5, ram[HL]);
+          Write8(cpu, HL, Read8(cpu, HL) | 1 << 5);
           DEBUG_PRINT("[INSTR] SET 5, (HL)\n");
           ++*pc;
           *cycles = 16;
@@ -3877,7 +3892,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
           *cycles = 8;
           break;
         case 0xF6:  // SET 6, (HL)
-          SET_BIT(6, ram[HL]);
+          Write8(cpu, HL, Read8(cpu, HL) | 1 << 6);
           DEBUG_PRINT("[INSTR] SET 6, (HL)\n");
           ++*pc;
           *cycles = 16;
@@ -3925,7 +3940,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
           *cycles = 8;
           break;
         case 0xFE:  // SET 7, (HL)
-          SET_BIT(7, ram[HL]);
+          Write8(cpu, HL, Read8(cpu, HL) | 1 << 7);
           DEBUG_PRINT("[INSTR] SET 7, (HL)\n");
           ++*pc;
           *cycles = 16;
@@ -3974,7 +3989,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
           *cycles = 8;
           break;
         case 0x86:  // RES 0, (HL)
-          RES_BIT(0, ram[HL]);
+          Write8(cpu, HL, Read8(cpu, HL) & ~(1 << 0));
           DEBUG_PRINT("[INSTR] RES 0, (HL)\n");
           ++*pc;
           *cycles = 16;
@@ -4022,7 +4037,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
           *cycles = 8;
           break;
         case 0x8E:  // RES 1, (HL)
-          RES_BIT(1, ram[HL]);
+          Write8(cpu, HL, Read8(cpu, HL) & ~(1 << 1));
           DEBUG_PRINT("[INSTR] RES 1, (HL)\n");
           ++*pc;
           *cycles = 16;
@@ -4070,7 +4085,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
           *cycles = 8;
           break;
         case 0x96:  // RES 2, (HL)
-          RES_BIT(2, ram[HL]);
+          Write8(cpu, HL, Read8(cpu, HL) & ~(1 << 2));
           DEBUG_PRINT("[INSTR] RES 2, (HL)\n");
           ++*pc;
           *cycles = 16;
@@ -4118,7 +4133,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
           *cycles = 8;
           break;
         case 0x9E:  // RES 3, (HL)
-          RES_BIT(3, ram[HL]);
+          Write8(cpu, HL, Read8(cpu, HL) & ~(1 << 3));
           DEBUG_PRINT("[INSTR] RES 3, (HL)\n");
           ++*pc;
           *cycles = 16;
@@ -4166,7 +4181,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
           *cycles = 8;
           break;
         case 0xA6:  // RES 4, (HL)
-          RES_BIT(4, ram[HL]);
+          Write8(cpu, HL, Read8(cpu, HL) & ~(1 << 4));
           DEBUG_PRINT("[INSTR] RES 4, (HL)\n");
           ++*pc;
           *cycles = 16;
@@ -4214,7 +4229,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
           *cycles = 8;
           break;
         case 0xAE:  // RES 5, (HL)
-          RES_BIT(5, ram[HL]);
+          Write8(cpu, HL, Read8(cpu, HL) & ~(1 << 5));
           DEBUG_PRINT("[INSTR] RES 5, (HL)\n");
           ++*pc;
           *cycles = 16;
@@ -4262,7 +4277,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
           *cycles = 8;
           break;
         case 0xB6:  // RES 6, (HL)
-          RES_BIT(6, ram[HL]);
+          Write8(cpu, HL, Read8(cpu, HL) & ~(1 << 6));
           DEBUG_PRINT("[INSTR] RES 6, (HL)\n");
           ++*pc;
           *cycles = 16;
@@ -4310,7 +4325,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
           *cycles = 8;
           break;
         case 0xBE:  // RES 7, (HL)
-          RES_BIT(7, ram[HL]);
+          Write8(cpu, HL, Read8(cpu, HL) & ~(1 << 7));
           DEBUG_PRINT("[INSTR] RES 7, (HL)\n");
           ++*pc;
           *cycles = 16;
@@ -4337,7 +4352,7 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
       GET_H ? 'H' : '_', GET_C ? 'C' : '_');
 
   if (*pc == 0xFFFF) {
-    dbg.trace = DBG_STEP;
+    dbg->trace = DBG_STEP;
   }
 
   if (*pc > 0xFF) {
@@ -4353,15 +4368,69 @@ int CpuStep(uint8_t *ram, uint16_t *pc, uint16_t *sp, struct Registers *reg,
       case 0xCC:
       case 0xD4:
       case 0xDC:
-        if (dbg.trace == DBG_STEP_OVER) DebugTrace(&dbg);
+        if (dbg->trace == DBG_STEP_OVER) DebugTrace(dbg);
     }
 
-    if (dbg.trace == DBG_STEP) DebugTrace(&dbg);
+    if (dbg->trace == DBG_STEP) DebugTrace(dbg);
   }
 
   return CPU_OK;
 }
 
+// the switch core is a single step per batch, its IO writes yield through
+// the bus like the table driven engines
+int CpuRun(struct gb *gb, uint32_t budget, uint32_t *cycles) {
+  struct cpu *cpu = &gb->cpu;
+  uint16_t pc = cpu->pc;
+  uint8_t step;
+
+  *cycles = 0;
+  cpu->yield = false;
+  if (!budget) return CPU_OK;
+
+  int state = CpuStep(gb, &step);
+  *cycles = step;
+  if (state == CPU_OK) TRACE_RECORD(gb, cpu, pc, step);  // DEBUG_PRINT prints
+  return state;
+}
+#endif
+
+// per instruction trace and debugger for the table driven engines, pc is
+// the address of the instruction that just ran
+void CpuTrace(struct gb *gb, struct cpu *cpu, uint16_t pc) {
+  struct debug *dbg = &gb->dbg;
+  struct trace_entry e = {.pc = pc,
+                          .bytes = {Read8(cpu, pc), Read8(cpu, pc + 1),
+                                    Read8(cpu, pc + 2)},
+                          .reg = cpu->reg,
+                          .sp = cpu->sp};
+
+  if (pc > 0x100) TracePrint(stdout, &e);
+
+  if (cpu->pc == 0xFFFF) {
+    dbg->trace = DBG_STEP;
+  }
+
+  if (cpu->pc > 0xFF) {
+    switch (e.bytes[0]) {
+      case 0xC9:
+      case 0xC0:
+      case 0xC8:
+      case 0xD0:
+      case 0xD8:
+      case 0xD9:
+      case 0xCD:
+      case 0xC4:
+      case 0xCC:
+      case 0xD4:
+      case 0xDC:
+        if (dbg->trace == DBG_STEP_OVER) DebugTrace(dbg);
+    }
+
+    if (dbg->trace == DBG_STEP) DebugTrace(dbg);
+  }
+}
+
 void DebugTrace(struct debug *dbg) {
   int c = getchar();
   switch (c) {
@@ -4380,14 +4449,6 @@ void DebugTrace(struct debug *dbg) {
   }
 }
 
-void DebugReadBlarggsSerial(uint8_t *ram) {
-  if (ram[0xFF02] == 0x81) {  // IO busy
-    char c = ram[0xFF01];     // read data
-    printf("%c", c);
-    ram[0xFF02] = 0x0;  // IO done
-  }
-}
-
 void PrintBinary8(uint8_t u8) {
   printf("%d", (u8 & (1 << 7)) != 0);
   printf("%d", (u8 & (1 << 6)) != 0);
@@ -4398,17 +4459,3 @@ void PrintBinary8(uint8_t u8) {
   printf("%d", (u8 & (1 << 1)) != 0);
   printf("%d ", (u8 & (1 << 0)) != 0);
 }
-
-void CoreDump(const char *fileName, uint8_t *ram) {
-  if (!fileName || !ram) {
-    return;
-  }
-
-  FILE *f = fopen(fileName, "w");
-  fwrite(ram, 1, 0x10000, f);
-  fclose(f);
-
-  printf("[ERROR] Core dumped at %s\n", fileName);
-
-  return;
-}
@@ -8,7 +8,34 @@
 #define CPU_ERROR_UNK_INSTRUCTION 1
 #define CPU_ERROR_FAULT 2
 
+// CPU engines, select with `make CPU_ENGINE=SWITCH|TABLE|THREADED`. They
+// start at 1 so an unknown name, which the preprocessor reads as 0, stops the
+// build.
+#define CPU_ENGINE_SWITCH 1    // original per-opcode switch in cpu.c
+#define CPU_ENGINE_TABLE 2     // handler tables in opcodes.c
+#define CPU_ENGINE_THREADED 3  // computed goto interpreter in threaded.c
+
+#ifndef CPU_ENGINE
+#define CPU_ENGINE CPU_ENGINE_TABLE
+#endif
+#if CPU_ENGINE != CPU_ENGINE_SWITCH && CPU_ENGINE != CPU_ENGINE_TABLE && \
+    CPU_ENGINE != CPU_ENGINE_THREADED
+#error "CPU_ENGINE must be SWITCH, TABLE or THREADED"
+#endif
+
+// trace tiers, select with `make TRACE=OFF|RING|PRINT|STREAM`
+#define CPU_TRACE_OFF 0     // compiled out
+#define CPU_TRACE_RING 1    // 16 byte records in a ring buffer, see trace.h
+#define CPU_TRACE_PRINT 2   // ring plus printf and debugger every instruction
+#define CPU_TRACE_STREAM 3  // every instruction to a delta encoded file
+
+#ifndef CPU_TRACE
+#define CPU_TRACE CPU_TRACE_OFF
+#endif
+
+#if CPU_TRACE == CPU_TRACE_PRINT
 #define DEBUG
+#endif
 
 #ifdef DEBUG
 #define DEBUG_PRINT(...)                  \
@@ -21,6 +48,15 @@
   } while (0)
 #endif
 
+// interrupt regs, IF and IE bits by priority
+#define IE 0xFFFF
+#define IF 0xFF0F
+#define INT_VBLANK 0x01
+#define INT_STAT 0x02
+#define INT_TIMER 0x04
+#define INT_SERIAL 0x08
+#define INT_JOYPAD 0x10
+
 #define RED "\x1B[31;7m"
 #define GRN "\x1B[32;7m"
 #define YEL "\x1B[33;7m"
@@ -74,15 +110,33 @@
   (((((n) & (0xFF)) + ((m) & (0xFF))) & 0x1000) == 0x1000)
 #define CARRY_16(n, m) (((uint32_t)(n + m) & 0x10000) == 0x10000)
 
+// ordered like the r8 operand encoding (B C D E H L (HL) A) so decoded
+// opcode fields index straight into it, F takes the (HL) slot
 struct Registers {
-  uint8_t a;
   uint8_t b;
   uint8_t c;
   uint8_t d;
   uint8_t e;
-  uint8_t f;
   uint8_t h;
   uint8_t l;
+  uint8_t f;
+  uint8_t a;
+};
+
+struct bus;
+
+struct cpu {
+  struct Registers reg;
+  uint16_t pc;
+  uint16_t sp;
+  bool ime;
+  bool ei;   // IME was just set by EI, one more instruction before it counts
+  bool irq;  // IE & IF & IME, updated by GbRun when one of them changes
+  bool hlt;
+  bool yield;  // ends the current CpuRun batch: an IO write or IME set
+  uint16_t io;  // address of the IO register written, 0 for none
+  uint32_t ran;  // cycles into the current CpuRun batch, see GbNow
+  struct bus* bus;
 };
 
 #define DBG_CONTINUE 0
@@ -93,9 +147,10 @@ struct debug {
   uint8_t trace;
 };
 
-int CpuStep(uint8_t* ram, unsigned short* pc, unsigned short* sp,
-            struct Registers* reg, bool* hlt, uint8_t* cycles, bool* IME);
-void DebugReadBlarggsSerial(uint8_t* ram);
+struct gb;
+
+int CpuStep(struct gb* gb, uint8_t* cycles);
+int CpuRun(struct gb* gb, uint32_t budget, uint32_t* cycles);
+void CpuTrace(struct gb* gb, struct cpu* cpu, uint16_t pc);
 void PrintBinary8(uint8_t u8);
-void CoreDump(const char* fileName, uint8_t* ram);
 void DebugTrace(struct debug* dbg);
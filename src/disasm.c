@@ -0,0 +1,149 @@
+#include "disasm.h"
+
+// operands are spelled like the comments in cpu.c and substituted on output
+static const char* const Mnemonics[0x100] = {
+    // 0x00
+    "NOP", "LD BC, u16", "LD (BC), A", "INC BC", "INC B", "DEC B", "LD B, u8",
+    "RLCA", "LD (u16), SP", "ADD HL, BC", "LD A, (BC)", "DEC BC", "INC C",
+    "DEC C", "LD C, u8", "RRCA",
+    // 0x10
+    "STOP", "LD DE, u16", "LD (DE), A", "INC DE", "INC D", "DEC D", "LD D, u8",
+    "RLA", "JR i8", "ADD HL, DE", "LD A, (DE)", "DEC DE", "INC E", "DEC E",
+    "LD E, u8", "RRA",
+    // 0x20
+    "JR NZ, i8", "LD HL, u16", "LD (HL+), A", "INC HL", "INC H", "DEC H",
+    "LD H, u8", "DAA", "JR Z, i8", "ADD HL, HL", "LD A, (HL+)", "DEC HL",
+    "INC L", "DEC L", "LD L, u8", "CPL",
+    // 0x30
+    "JR NC, i8", "LD SP, u16", "LD (HL-), A", "INC SP", "INC (HL)", "DEC (HL)",
+    "LD (HL), u8", "SCF", "JR C, i8", "ADD HL, SP", "LD A, (HL-)", "DEC SP",
+    "INC A", "DEC A", "LD A, u8", "CCF",
+    // 0x40
+    "LD B, B", "LD B, C", "LD B, D", "LD B, E", "LD B, H", "LD B, L",
+    "LD B, (HL)", "LD B, A", "LD C, B", "LD C, C", "LD C, D", "LD C, E",
+    "LD C, H", "LD C, L", "LD C, (HL)", "LD C, A",
+    // 0x50
+    "LD D, B", "LD D, C", "LD D, D", "LD D, E", "LD D, H", "LD D, L",
+    "LD D, (HL)", "LD D, A", "LD E, B", "LD E, C", "LD E, D", "LD E, E",
+    "LD E, H", "LD E, L", "LD E, (HL)", "LD E, A",
+    // 0x60
+    "LD H, B", "LD H, C", "LD H, D", "LD H, E", "LD H, H", "LD H, L",
+    "LD H, (HL)", "LD H, A", "LD L, B", "LD L, C", "LD L, D", "LD L, E",
+    "LD L, H", "LD L, L", "LD L, (HL)", "LD L, A",
+    // 0x70
+    "LD (HL), B", "LD (HL), C", "LD (HL), D", "LD (HL), E", "LD (HL), H",
+    "LD (HL), L", "HALT", "LD (HL), A", "LD A, B", "LD A, C", "LD A, D",
+    "LD A, E", "LD A, H", "LD A, L", "LD A, (HL)", "LD A, A",
+    // 0x80
+    "ADD A, B", "ADD A, C", "ADD A, D", "ADD A, E", "ADD A, H", "ADD A, L",
+    "ADD A, (HL)", "ADD A, A", "ADC A, B", "ADC A, C", "ADC A, D", "ADC A, E",
+    "ADC A, H", "ADC A, L", "ADC A, (HL)", "ADC A, A",
+    // 0x90
+    "SUB A, B", "SUB A, C", "SUB A, D", "SUB A, E", "SUB A, H", "SUB A, L",
+    "SUB A, (HL)", "SUB A, A", "SBC A, B", "SBC A, C", "SBC A, D", "SBC A, E",
+    "SBC A, H", "SBC A, L", "SBC A, (HL)", "SBC A, A",
+    // 0xA0
+    "AND A, B", "AND A, C", "AND A, D", "AND A, E", "AND A, H", "AND A, L",
+    "AND A, (HL)", "AND A, A", "XOR A, B", "XOR A, C", "XOR A, D", "XOR A, E",
+    "XOR A, H", "XOR A, L", "XOR A, (HL)", "XOR A, A",
+    // 0xB0
+    "OR A, B", "OR A, C", "OR A, D", "OR A, E", "OR A, H", "OR A, L",
+    "OR A, (HL)", "OR A, A", "CP A, B", "CP A, C", "CP A, D", "CP A, E",
+    "CP A, H", "CP A, L", "CP A, (HL)", "CP A, A",
+    // 0xC0
+    "RET NZ", "POP BC", "JP NZ, u16", "JP u16", "CALL NZ, u16", "PUSH BC",
+    "ADD A, u8", "RST 00h", "RET Z", "RET", "JP Z, u16", "PREFIX CB",
+    "CALL Z, u16", "CALL u16", "ADC A, u8", "RST 08h",
+    // 0xD0
+    "RET NC", "POP DE", "JP NC, u16", "???", "CALL NC, u16", "PUSH DE",
+    "SUB A, u8", "RST 10h", "RET C", "RETI", "JP C, u16", "???", "CALL C, u16",
+    "???", "SBC A, u8", "RST 18h",
+    // 0xE0
+    "LD (FF00 + u8), A", "POP HL", "LD (FF00 + C), A", "???", "???", "PUSH HL",
+    "AND A, u8", "RST 20h", "ADD SP, i8", "JP (HL)", "LD (u16), A", "???",
+    "???", "???", "XOR A, u8", "RST 28h",
+    // 0xF0
+    "LD A, (FF00 + u8)", "POP AF", "LD A, (FF00 + C)", "DI", "???", "PUSH AF",
+    "OR A, u8", "RST 30h", "LD HL, SP+i8", "LD SP, HL", "LD A, (u16)", "EI",
+    "???", "???", "CP A, u8", "RST 38h",
+};
+
+const uint8_t DisasmLengths[0x100] = {
+    /* 0x00 */ 1, 3, 1, 1, 1, 1, 2, 1, 3, 1, 1, 1, 1, 1, 2, 1,
+    /* 0x10 */ 2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1,
+    /* 0x20 */ 2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1,
+    /* 0x30 */ 2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1,
+    /* 0x40 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    /* 0x50 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    /* 0x60 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    /* 0x70 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    /* 0x80 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    /* 0x90 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    /* 0xA0 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    /* 0xB0 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    /* 0xC0 */ 1, 1, 3, 3, 3, 1, 2, 1, 1, 1, 3, 2, 3, 3, 2, 1,
+    /* 0xD0 */ 1, 1, 3, 1, 3, 1, 2, 1, 1, 1, 3, 1, 3, 1, 2, 1,
+    /* 0xE0 */ 2, 1, 1, 1, 1, 1, 2, 1, 2, 1, 3, 1, 1, 1, 2, 1,
+    /* 0xF0 */ 2, 1, 1, 1, 1, 1, 2, 1, 2, 1, 3, 1, 1, 1, 2, 1,
+};
+
+static const char* const R8Names[8] = {"B", "C", "D", "E",
+                                       "H", "L", "(HL)", "A"};
+static const char* const CbNames[8] = {"RLC", "RRC", "RL",   "RR",
+                                       "SLA", "SRA", "SWAP", "SRL"};
+
+int DisasmInstr(char* text, size_t size, uint16_t pc, const uint8_t bytes[3]) {
+  uint8_t opcode = bytes[0];
+
+  if (opcode == 0xCB) {
+    uint8_t cb = bytes[1];
+    uint8_t y = (cb >> 3) & 7;
+    const char* r = R8Names[cb & 7];
+    switch (cb >> 6) {
+      case 0:
+        snprintf(text, size, "%s %s", CbNames[y], r);
+        break;
+      case 1:
+        snprintf(text, size, "BIT %d, %s", y, r);
+        break;
+      case 2:
+        snprintf(text, size, "RES %d, %s", y, r);
+        break;
+      case 3:
+        snprintf(text, size, "SET %d, %s", y, r);
+        break;
+    }
+    return 2;
+  }
+
+  const char* mnemonic = Mnemonics[opcode];
+  const char* operand;
+  char value[8];
+  int length = 1;
+
+  if ((operand = strstr(mnemonic, "u16"))) {
+    snprintf(value, sizeof(value), "$%04X", bytes[1] | bytes[2] << 010);
+    length = 3;
+  } else if ((operand = strstr(mnemonic, "u8"))) {
+    snprintf(value, sizeof(value), "$%02X", bytes[1]);
+    length = 2;
+  } else if ((operand = strstr(mnemonic, "i8"))) {
+    if (mnemonic[0] == 'J')  // JR prints its target
+      snprintf(value, sizeof(value), "$%04X",
+               (uint16_t)(pc + 2 + (int8_t)bytes[1]));
+    else
+      snprintf(value, sizeof(value), "$%02X", bytes[1]);
+    length = 2;
+  } else if (opcode == 0x10) {  // STOP
+    length = 2;
+  }
+
+  if (!operand) {
+    snprintf(text, size, "%s", mnemonic);
+  } else {
+    int skip = operand[1] == '1' ? 3 : 2;
+    snprintf(text, size, "%.*s%s%s", (int)(operand - mnemonic), mnemonic,
+             value, operand + skip);
+  }
+  return length;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// instruction length in bytes by opcode, 0xCB counts its second byte
+extern const uint8_t DisasmLengths[0x100];
+
+// Formats the instruction at pc into text, bytes holds the opcode and the
+// two bytes following it. Returns the instruction length.
+int DisasmInstr(char* text, size_t size, uint16_t pc, const uint8_t bytes[3]);
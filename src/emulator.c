@@ -1,31 +1,123 @@
 #define _POSIX_C_SOURCE 200809L
 
 #define TEST_DIR "test/gb-test-roms/cpu_instrs/individual/"
+#define REWIND_BYTES_PER_SECOND (256 << 10)  // more than most roms need
+#define REWIND_SECONDS_MAX 3600  // ring offsets are 32 bit
+#define REWIND_INTERVAL_MAX 600
 
 #include <MiniFB.h>
+#include <errno.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "boot.h"
 #include "cpu.h"
+#include "frames.h"
+#include "gb.h"
+#include "pacer.h"
+#include "ppu.h"
+#include "rewind.h"
 #include "rom.h"
+#include "snap.h"
+#include "trace.h"
 #include "window.h"
 
-static volatile int keepRunning = 1;
+static volatile sig_atomic_t keepRunning = 1;
 
-static uint8_t* rom;
-static uint8_t ram[0x10000];  // $0000-$FFFF
-void coreDumpHandle(int dummy) {
-  CoreDump("core-GameboyEmulator.dmp", ram);
-  free(rom);
+static struct gb gb;
+static struct pacer pacer;
+static struct rewind history;  // what Backspace goes back through
+
+// the machine is only saved between frames, the main loop stops there
+void coreDumpHandle(int dummy) { keepRunning = 0; }
+
+static void CoreDump(void) {
+  PacerPrint(&pacer, stdout);
+  SnapWrite(&gb, "core-GameboyEmulator.gbs");
+#if CPU_TRACE == CPU_TRACE_RING || CPU_TRACE == CPU_TRACE_PRINT
+  TraceDump(gb.trace, "core-GameboyEmulator.trace");
+#endif
+  RewindFree(&history);
+  GbFree(&gb);
   exit(0);
 }
 
-int main() {
+// a whole number from min to max, false for anything else
+static bool ParseNumber(const char* text, unsigned long min, unsigned long max,
+                        unsigned long* out) {
+  char* end;
+
+  errno = 0;
+  *out = strtoul(text, &end, 10);
+  return end != text && !*end && !errno && *out >= min && *out <= max;
+}
+
+static void Usage(const char* name) {
+  printf(
+      "usage: %s [-s speed] [-f skip] [-l state] [-r seconds] [-i frames]\n"
+      "  -s  times real time up to 1000, 0 runs as fast as it goes, default 1\n"
+      "  -f  frames left out after each one drawn, 0-255, default 0\n"
+      "  -l  carry on from a save state, Ctrl-C saves one\n"
+      "  -r  seconds Backspace can rewind up to 3600, 0 for none, default 60\n"
+      "  -i  frames between rewind states, 1-600, default 1\n",
+      name);
+}
+
+int main(int argc, char** argv) {
+  uint32_t speed = 1;
+  uint8_t frameSkip = 0;
+  const char* state = NULL;
+  uint32_t seconds = 60, interval = 1;
+  unsigned long number;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "s:f:l:r:i:")) != -1) {
+    switch (opt) {
+      case 's':
+        // the pacer's cycles to ns would overflow much past that
+        if (!ParseNumber(optarg, 0, PACER_SPEED_MAX, &number)) {
+          Usage(argv[0]);
+          return 1;
+        }
+        speed = number;
+        break;
+      case 'f':
+        // ppu.frameSkip is a byte, larger counts would wrap
+        if (!ParseNumber(optarg, 0, UINT8_MAX, &number)) {
+          Usage(argv[0]);
+          return 1;
+        }
+        frameSkip = number;
+        break;
+      case 'l':
+        state = optarg;
+        break;
+      case 'r':
+        if (!ParseNumber(optarg, 0, REWIND_SECONDS_MAX, &number)) {
+          Usage(argv[0]);
+          return 1;
+        }
+        seconds = number;
+        break;
+      case 'i':
+        if (!ParseNumber(optarg, 1, REWIND_INTERVAL_MAX, &number)) {
+          Usage(argv[0]);
+          return 1;
+        }
+        interval = number;
+        break;
+      default:
+        Usage(argv[0]);
+        return 1;
+    }
+  }
+
   printf("Launched\n");
 
   signal(SIGINT, coreDumpHandle);
@@ -46,24 +138,16 @@ int main() {
                                        "11-op a,(hl).gb"};
 
   // TEST
-  uint8_t rom_reboot_vec[0x100];
+  static struct cart cart;
   char file[128];
   sprintf(file, TEST_DIR "%s", DebugFiles[0]);
-  if (BootLoadTestRom(&rom, file)) {
+  if (BootMapRom(&cart, file)) {
     printf("Rom loading failed. Exiting\n");
     return 1;
   }
-  // BootLoadTestRom(&rom, "roms/Tetris (World) (Rev A).gb");
-  // BootLoadTestRom(&rom, "roms/Dr. Mario (World).gb");
-  // BootLoadTestRom(&rom, "roms/Link's Awakening.gb");
-  // SWAP
-  memcpy(rom_reboot_vec, rom, 0x100);
-
-  // WINDOW
-  static uint32_t framebuffer[256 * 256];  // Main Screen buffer @ 32x32 tiles
-  struct mfb_window* window =
-      mfb_open("Gameboy Emulator", DISPLAY_WIDTH << 1, DISPLAY_HEIGHT << 1);
-  WinInit(window, DISPLAY_WIDTH << 1, DISPLAY_HEIGHT << 1);
+  // BootMapRom(&cart, "roms/Tetris (World) (Rev A).gb");
+  // BootMapRom(&cart, "roms/Dr. Mario (World).gb");
+  // BootMapRom(&cart, "roms/Link's Awakening.gb");
 
   // TILEWINDOW
   /*
@@ -74,85 +158,65 @@ int main() {
   */
 
   // CPU
-  memset(ram, 0x00, 0x10000);
-  memcpy(ram, rom, 0x4000);                    // copy BNK0
-  memcpy(ram + 0x4000, rom + 0x4000, 0x4000);  // copy BNK0
-  memcpy(ram, boot, 0x100);                    // insert BIOS
-  uint8_t cycles;
-  bool IME = false;
+  if (GbInit(&gb, &cart, boot)) return 1;
+
+  // WINDOW, on its own thread, frames are handed over at every VBlank
+  static struct frames frames;
+  FramesInit(&frames);
+  PpuAttach(&gb, &frames);
+  gb.ppu.frameSkip = frameSkip;
+  if (state && SnapRead(&gb, state)) return 1;
+  if (seconds > SIZE_MAX / REWIND_BYTES_PER_SECOND) {
+    printf("[ERROR] %s: a %u second rewind buffer doesn't fit\n", __func__,
+           seconds);
+    return 1;
+  }
+  if (seconds && RewindInit(&history, &gb, interval, seconds * 60 / interval,
+                            (size_t)seconds * REWIND_BYTES_PER_SECOND))
+    return 1;
+  if (WinStart(&frames)) return 1;
 
   // GB HEADER
   // Cartridge Type:
-  PrintRomType(ram);
-  PrintRomSize(ram);
-  PrintRamSize(ram);
-
-  // INTERRUPTS
-  ram[0xFFFF] = 0x00;  // IE
-  ram[0xFF0F] = 0xe0;  // IF
-
-  unsigned short pc = 0x0, sp = 0xFFFE;
-  struct Registers reg = {.a = 0x00,
-                          .b = 0x00,
-                          .c = 0x00,
-                          .d = 0x00,
-                          .e = 0x00,
-                          .f = 0x00,
-                          .h = 0x00,
-                          .l = 0x00};
-  bool hlt = false;
-
-  struct timespec timerA, timerB;
-
-  while (1) {
-    const int MAXCYCLES = 69905;
-    int cyclesThisUpdate = 0;
-    while (cyclesThisUpdate < MAXCYCLES) {
-      // start timer
-      clock_gettime(CLOCK_REALTIME, &timerA);
-      // ROM SWAP
-      // TODO: Evaluate old value and update with ram read inside if!
-      if (ram[0xFF50]) {
-        memcpy(ram, rom_reboot_vec, 0x100);
-        memcpy(rom, rom_reboot_vec, 0x100);
-        ram[0xFF50] = 0;
-      }
-      // CPU
-      if (!hlt) {
-        if (CpuStep(ram, &pc, &sp, &reg, &hlt, &cycles, &IME) != CPU_OK) {
-          getchar();
-          exit(0);
-        }
-        DebugReadBlarggsSerial(ram);
-      }
-      // UPDATE
-      cyclesThisUpdate += cycles;
-      // PPU
-      GraphicsUpdate(cycles, ram);
-    }
-    if (timerB.tv_nsec < timerA.tv_nsec) {
-      timerB.tv_nsec += 1e9;
+  PrintRomType(cart.data);
+  PrintRomSize(cart.data);
+  PrintRamSize(cart.data);
+
+#if CPU_TRACE == CPU_TRACE_STREAM
+  if (TraceStreamOpen(gb.trace, "GameboyEmulator.gbt")) return 1;
+#endif
+
+  // a frame at a time, each one shown and then held until it's due
+  PacerInit(&pacer, CPU_HZ);
+  PacerSpeed(&pacer, speed, gb.sched.now);
+  for (uint64_t frameEnd = gb.sched.now + FRAME_CYCLES; keepRunning;
+       frameEnd += FRAME_CYCLES) {
+    // Backspace held goes back a state a frame and shows the frame run from
+    // there, the timeline starts over at the restored time
+    if (seconds && WinRewinding() && RewindStep(&history, &gb)) {
+      frameEnd = gb.sched.now + FRAME_CYCLES;
+      PacerSpeed(&pacer, speed, gb.sched.now);
+    } else if (seconds) {
+      RewindFrame(&history, &gb);
     }
 
-    if (window) WinUpdate(window, framebuffer, ram);
-    if (window)
-      if (!mfb_wait_sync(window)) window = 0x0;
+    // runs the cpu and everything clocked with it up to the frame end
+    if (GbRun(&gb, frameEnd) != CPU_OK) {
+#if CPU_TRACE == CPU_TRACE_RING || CPU_TRACE == CPU_TRACE_PRINT
+      TraceDump(gb.trace, "core-GameboyEmulator.trace");
+#endif
+      GbFree(&gb);
+      getchar();
+      exit(0);
+    }
     /*
-    if (tilewindow) TileUpdate(tilewindow, tilebuffer, ram);
+    if (tilewindow) TileUpdate(tilewindow, tilebuffer, &gb);
     if (tilewindow)
       if (!mfb_wait_sync(tilewindow)) tilewindow = 0x0;
       */
-    // TIMER SYNC
-    /*
-    clock_gettime(CLOCK_REALTIME, &timerB);
-    if (timerB.tv_nsec < timerA.tv_nsec) {
-      timerB.tv_nsec += 1e9;
-    }
-    uint64_t timediff = (timerB.tv_nsec - timerA.tv_nsec) - 16666666;
-    if ((-timediff) > 100000)
-      nanosleep(&(struct timespec){.tv_nsec = (-timediff - 50000)}, NULL);
-    */
+    PacerWait(&pacer, frameEnd);
   }
+  CoreDump();
 
   return 0;
 }
@@ -0,0 +1,27 @@
+#include "frames.h"
+
+#include <string.h>
+
+void FramesInit(struct frames* frames) {
+  memset(frames, 0, sizeof(*frames));
+  frames->back = 0;
+  frames->middle = 1;
+  frames->front = 2;
+}
+
+void FramesPublish(struct frames* frames) {
+  uint8_t old = __atomic_exchange_n(
+      &frames->middle, frames->back | FRAMES_FRESH, __ATOMIC_ACQ_REL);
+  if (old & FRAMES_FRESH) frames->dropped++;
+  frames->back = old & ~FRAMES_FRESH;
+  frames->published++;
+}
+
+bool FramesTake(struct frames* frames) {
+  if (!(__atomic_load_n(&frames->middle, __ATOMIC_ACQUIRE) & FRAMES_FRESH))
+    return false;
+  uint8_t old =
+      __atomic_exchange_n(&frames->middle, frames->front, __ATOMIC_ACQ_REL);
+  frames->front = old & ~FRAMES_FRESH;
+  return true;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ppu.h"
+
+// Lock free triple buffer of finished frames between the machine and a
+// viewer. The PPU draws into back and swaps it with middle at VBlank, the
+// viewer swaps front with middle when a newer frame is there. Neither side
+// ever waits for the other, a frame the viewer didn't take in time is
+// dropped.
+#define FRAMES_FRESH 0x80  // middle holds a frame the viewer hasn't taken
+
+struct frames {
+  uint8_t buffers[3][DISPLAY_HEIGHT][DISPLAY_WIDTH];  // shades, as ppu.frame
+
+  // each index on its own cache line, only middle is shared
+  uint8_t back __attribute__((aligned(64)));
+  uint32_t published;
+  uint32_t dropped;
+  uint8_t middle __attribute__((aligned(64)));
+  uint8_t front __attribute__((aligned(64)));
+};
+
+void FramesInit(struct frames* frames);
+
+// machine side, back becomes the newest frame and the PPU gets another one
+void FramesPublish(struct frames* frames);
+
+// viewer side, true when front was replaced by a newer frame
+bool FramesTake(struct frames* frames);
@@ -0,0 +1,133 @@
+#include "gb.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "io.h"
+#include "ops.h"
+
+// longest cpu batch, CpuRun's count may run past it by an instruction
+#define GB_BATCH_MAX (1u << 30)
+
+// cart has to stay mapped while the machine runs. Runs boot when given,
+// otherwise starts from the state the boot rom leaves behind.
+int GbInit(struct gb* gb, const struct cart* cart, const uint8_t boot[0x100]) {
+  memset(gb, 0, sizeof(*gb));
+  gb->cart = cart;
+#if CPU_TRACE != CPU_TRACE_OFF
+  gb->trace = calloc(1, sizeof(*gb->trace));
+  if (!gb->trace) {
+    printf("[ERROR] %s: no memory for the trace\n", __func__);
+    return GB_ERROR_MEMORY;
+  }
+  gb->idle.off = true;  // skipped passes would be missing from the trace
+#endif
+  gb->serial = stdout;
+  gb->dbg.trace = DBG_CONTINUE;
+
+  gb->ram[IE] = 0x00;
+  gb->ram[IF] = 0xE0;
+
+  gb->cpu.sp = 0xFFFE;
+  gb->cpu.bus = &gb->bus;
+  BusInit(gb, boot != NULL);
+  if (MbcInit(gb)) return GB_ERROR_MEMORY;
+  if (boot) {
+    memcpy(gb->boot, boot, 0x100);
+  } else {
+    gb->cpu.reg = (struct Registers){.a = 0x01,
+                                     .f = 0xB0,
+                                     .b = 0x00,
+                                     .c = 0x13,
+                                     .d = 0x00,
+                                     .e = 0xD8,
+                                     .h = 0x01,
+                                     .l = 0x4D};
+    gb->cpu.pc = 0x100;
+    gb->ram[LCDC] = 0x91;
+    gb->ram[BGP] = 0xFC;
+    gb->ram[IF] = 0xE1;
+    gb->ram[BOOT] = 0x01;
+  }
+
+  SchedInit(&gb->sched);
+  TimerInit(gb, boot ? 0 : 0xABCC);
+  PpuInit(gb);
+  return GB_OK;
+}
+
+void GbFree(struct gb* gb) {
+  if (gb->trace) TraceStreamClose(gb->trace);
+  free(gb->trace);
+  MbcFree(gb);
+  gb->trace = NULL;
+}
+
+// IE, IF or IME may have changed. A requested and enabled interrupt also
+// ends HALT, with IME off the cpu just carries on.
+static void GbIrqUpdate(struct gb* gb) {
+  uint8_t pending = gb->ram[IE] & gb->ram[IF] & 0x1F;
+
+  if (pending) gb->cpu.hlt = false;
+  gb->cpu.irq = pending && gb->cpu.ime;
+}
+
+// calls the highest priority pending interrupt, 5 M-cycles
+static uint32_t GbInterrupt(struct gb* gb) {
+  struct cpu* cpu = &gb->cpu;
+  uint8_t bit = __builtin_ctz(gb->ram[IE] & gb->ram[IF] & 0x1F);
+
+  gb->ram[IF] &= ~(1 << bit);
+  cpu->ime = false;
+  cpu->irq = false;
+  cpu->yield = false;
+  Push16(cpu, cpu->pc);  // can hit IE, then yields like any IO write
+  cpu->pc = 0x40 + (bit << 3);
+  return 20;
+}
+
+// Runs until the scheduler reaches until (absolute cycles), returns CPU_OK or
+// the cpu error. The cpu runs in batches up to the next event, which are
+// dispatched once they came due. Interrupts are only looked for between
+// batches: whatever can raise one (IO writes, EI, RETI, events) ends a batch.
+int GbRun(struct gb* gb, uint64_t until) {
+  struct sched* sched = &gb->sched;
+  struct cpu* cpu = &gb->cpu;
+  uint32_t cycles;
+
+  while (sched->now < until) {
+    uint64_t next = SchedNext(sched) < until ? SchedNext(sched) : until;
+    if (cpu->irq && !cpu->ei) {
+      cycles = GbInterrupt(gb);
+    } else if (!cpu->hlt && !cpu->ei && IdleRun(gb, next)) {
+      cycles = 0;  // polling loop, ran and skipped on its own
+    } else if (!cpu->hlt) {
+      // right after EI only the instruction it lets through, with the LCD
+      // off next may be further away than a batch counts
+      uint64_t left = next - sched->now;
+      uint32_t budget = cpu->ei ? 1 : left < GB_BATCH_MAX ? left : GB_BATCH_MAX;
+      cpu->ei = false;
+      int state = CpuRun(gb, budget, &cycles);
+      if (state != CPU_OK) return state;
+    } else {
+      // only an event can raise the interrupt that ends HALT or STOP, so
+      // time goes straight to the next one, in whole M-cycles
+      uint64_t left = next - sched->now;
+      cycles = ((left < GB_BATCH_MAX ? left : GB_BATCH_MAX) + 3) & ~3u;
+    }
+    sched->now += cycles;
+    cpu->ran = 0;
+    if (cpu->yield) {
+      if (cpu->io) IoWrite(gb, cpu->io);
+      cpu->io = 0;
+      cpu->yield = false;
+      GbIrqUpdate(gb);
+    }
+    if (SchedNext(sched) <= sched->now) {
+      while (SchedNext(sched) <= sched->now) IoEvent(gb, SchedPop(sched));
+      GbIrqUpdate(gb);
+      IdleLeft(&gb->idle, cpu->pc);
+    }
+  }
+  return CPU_OK;
+}
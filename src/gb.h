@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "boot.h"
+#include "bus.h"
+#include "cpu.h"
+#include "idle.h"
+#include "mbc.h"
+#include "ppu.h"
+#include "sched.h"
+#include "timer.h"
+#include "trace.h"
+
+#define GB_OK 0
+#define GB_ERROR_MEMORY 1
+
+#define CPU_HZ 4194304  // FRAME_CYCLES a frame makes 59.7275 frames a second
+
+// One machine. Everything a running rom touches lives here, so any number of
+// them can run side by side, one per thread.
+struct gb {
+  struct cpu cpu;
+  struct bus bus;
+  struct mbc mbc;
+  struct sched sched;
+  struct ppu ppu;
+  struct timer timer;
+  struct idle idle;
+  struct debug dbg;
+  struct trace* trace;      // NULL with TRACE=OFF
+  FILE* serial;             // receives what the rom sends over serial
+  const struct cart* cart;  // shared, outlives the machine
+  uint8_t boot[0x100];      // boot rom, over BNK0 until the write to BOOT
+  uint8_t ram[0x10000];     // $8000-$FFFF, the bus reads rom from the cart
+};
+
+int GbInit(struct gb* gb, const struct cart* cart, const uint8_t boot[0x100]);
+void GbFree(struct gb* gb);
+int GbRun(struct gb* gb, uint64_t until);
+
+// the cycle the running instruction started at, also inside a cpu batch
+static inline uint64_t GbNow(const struct gb* gb) {
+  return gb->sched.now + gb->cpu.ran;
+}
@@ -0,0 +1,191 @@
+#include "idle.h"
+
+#include <string.h>
+
+#include "disasm.h"
+#include "gb.h"
+
+// what an instruction may do in an idle loop
+#define IDLE_NO 0    // writes memory, touches the stack or IME, stops
+#define IDLE_OP 1    // registers and flags only
+#define IDLE_READ 2  // reads memory, checked against IdleStable
+#define IDLE_JUMP 3  // JR or JP, conditional or not
+
+__extension__ static const uint8_t IdleOps[0x100] = {
+    [0x00 ... 0x3F] = IDLE_OP,
+    [0x02] = IDLE_NO, [0x08] = IDLE_NO, [0x10] = IDLE_NO, [0x12] = IDLE_NO,
+    [0x22] = IDLE_NO, [0x32] = IDLE_NO, [0x34 ... 0x36] = IDLE_NO,
+    [0x0A] = IDLE_READ, [0x1A] = IDLE_READ, [0x2A] = IDLE_READ,
+    [0x3A] = IDLE_READ,
+    [0x18] = IDLE_JUMP, [0x20] = IDLE_JUMP, [0x28] = IDLE_JUMP,
+    [0x30] = IDLE_JUMP, [0x38] = IDLE_JUMP,
+
+    // LD r,r and ALU A,r, (HL) is column 6
+    [0x40 ... 0xBF] = IDLE_OP,
+    [0x46] = IDLE_READ, [0x4E] = IDLE_READ, [0x56] = IDLE_READ,
+    [0x5E] = IDLE_READ, [0x66] = IDLE_READ, [0x6E] = IDLE_READ,
+    [0x70 ... 0x77] = IDLE_NO,
+    [0x7E] = IDLE_READ, [0x86] = IDLE_READ, [0x8E] = IDLE_READ,
+    [0x96] = IDLE_READ, [0x9E] = IDLE_READ, [0xA6] = IDLE_READ,
+    [0xAE] = IDLE_READ, [0xB6] = IDLE_READ, [0xBE] = IDLE_READ,
+
+    [0xC2] = IDLE_JUMP, [0xC3] = IDLE_JUMP, [0xCA] = IDLE_JUMP,
+    [0xD2] = IDLE_JUMP, [0xDA] = IDLE_JUMP,
+    [0xC6] = IDLE_OP, [0xCE] = IDLE_OP, [0xD6] = IDLE_OP, [0xDE] = IDLE_OP,
+    [0xE6] = IDLE_OP, [0xEE] = IDLE_OP, [0xF6] = IDLE_OP, [0xFE] = IDLE_OP,
+    [0xF0] = IDLE_READ, [0xF2] = IDLE_READ, [0xFA] = IDLE_READ,
+};
+
+static uint8_t IdleOp(const struct bus* bus, uint16_t pc) {
+  uint8_t opcode = BusRead(bus, pc);
+  if (opcode != 0xCB) return IdleOps[opcode];
+
+  // on (HL) BIT only reads, the others write back
+  uint8_t cb = BusRead(bus, pc + 1);
+  if ((cb & 0x07) != 6) return IDLE_OP;
+  return cb >= 0x40 && cb < 0x80 ? IDLE_READ : IDLE_NO;
+}
+
+// Follows the instructions from start, backward branches taken and forward
+// ones not, and tells whether they come back to start. Only looks at the
+// kind of each instruction, IdleRun checks the reads as they run. The range
+// the path went through ends up in from-to.
+static bool IdleLoopAt(struct idle* idle, const struct bus* bus,
+                       uint16_t start) {
+  uint16_t pc = start;
+
+  idle->from = idle->to = start;
+  for (int i = 0; i < IDLE_MAX_OPS; i++) {
+    uint8_t kind = IdleOp(bus, pc);
+    uint8_t opcode = BusRead(bus, pc);
+    uint16_t next = pc + DisasmLengths[opcode];
+
+    if (kind == IDLE_NO) return false;
+    if (kind == IDLE_JUMP) {
+      uint16_t target = next + (int8_t)BusRead(bus, pc + 1);
+      if (opcode >= 0xC0)
+        target = BusRead(bus, pc + 1) | BusRead(bus, pc + 2) << 010;
+      if (opcode == 0x18 || opcode == 0xC3 || target <= pc) next = target;
+    }
+    pc = next;
+    if (pc == start) return true;
+    if (pc < idle->from) idle->from = pc;
+    if (pc > idle->to) idle->to = pc;
+  }
+  return false;
+}
+
+// IdleLoopAt for code in rom, the same pc with the same banks mapped decodes
+// the same. Paths over more than two pages or into ram are decoded each time.
+static bool IdleLoopCached(struct idle* idle, const struct bus* bus,
+                           uint16_t start) {
+  struct idle_loop* c = &idle->cache[start & (IDLE_CACHE_SIZE - 1)];
+
+  // the last instruction's operands may be on the page after to
+  if (c->pages[0] && c->pc == start &&
+      c->pages[0] == bus->read[c->from >> 010] &&
+      c->pages[1] == bus->read[(c->to + 2) >> 010]) {
+    idle->from = c->from;
+    idle->to = c->to;
+    return c->loop;
+  }
+
+  bool loop = IdleLoopAt(idle, bus, start);
+  uint8_t first = idle->from >> 010, last = (idle->to + 2) >> 010;
+  c->pages[0] = NULL;
+  if (idle->to + 2 < 0x8000 && last - first <= 1 && bus->read[first] &&
+      bus->read[last])
+    *c = (struct idle_loop){.pages = {bus->read[first], bus->read[last]},
+                            .pc = start,
+                            .from = idle->from,
+                            .to = idle->to,
+                            .loop = loop};
+  return loop;
+}
+
+// the address the instruction at pc reads with the registers as they are now
+static uint16_t IdleAddress(const struct cpu* cpu) {
+  const struct Registers* reg = &cpu->reg;
+  uint8_t opcode = BusRead(cpu->bus, cpu->pc);
+
+  switch (opcode) {
+    case 0x0A:
+      return BC;
+    case 0x1A:
+      return DE;
+    case 0xF0:
+      return 0xFF00 | BusRead(cpu->bus, cpu->pc + 1);
+    case 0xF2:
+      return 0xFF00 | reg->c;
+    case 0xFA:
+      return BusRead(cpu->bus, cpu->pc + 1) |
+             BusRead(cpu->bus, cpu->pc + 2) << 010;
+  }
+  return HL;
+}
+
+// Whether the instruction at pc can run in an idle loop. The path taken may
+// leave the one IdleLoopAt followed, so it's checked again. IO registers and
+// HRAM only change with a write or an event, except the timer counting on
+// its own.
+static bool IdleStable(const struct cpu* cpu) {
+  uint8_t kind = IdleOp(cpu->bus, cpu->pc);
+  if (kind != IDLE_READ) return kind != IDLE_NO;
+
+  uint16_t addr = IdleAddress(cpu);
+  return addr >= 0xFF00 && addr != DIV && addr != TIMA;
+}
+
+// Runs an instruction at a time so every read is checked with the registers
+// it happens with. A pass that ends with the registers it started with shows
+// every pass until the next event will. The first may start with registers
+// from before the loop or the last event, so it gets a second chance. Whole
+// passes up to next are then skipped, the rest of the way is left to the cpu
+// so it ends up exactly where running every pass would have. A loop that
+// fails inside isn't looked at again until the cpu left it.
+bool IdleRun(struct gb* gb, uint64_t next) {
+  struct cpu* cpu = &gb->cpu;
+  struct sched* sched = &gb->sched;
+  struct idle* idle = &gb->idle;
+  uint16_t start = cpu->pc;
+  uint64_t from = sched->now, passFrom = from;
+  struct Registers reg = cpu->reg;
+  uint16_t sp = cpu->sp;
+  bool retried = false;
+
+  if (idle->off || next - sched->now < IDLE_MIN_CYCLES) return false;
+  if (idle->miss && start >= idle->from && start <= idle->to) return false;
+  idle->miss = false;
+  if (!IdleLoopCached(idle, cpu->bus, start)) {
+    idle->miss = true;
+    return false;
+  }
+
+  for (int i = 0; i < 2 * IDLE_MAX_OPS; i++) {
+    uint32_t cycles;
+    // out of time before telling, nothing is known about the loop
+    if (sched->now >= next) return true;
+    if (!IdleStable(cpu) || CpuRun(gb, 1, &cycles) != CPU_OK) break;
+    sched->now += cycles;
+    cpu->ran = 0;
+    if (cpu->pc != start) continue;
+
+    if (memcmp(&cpu->reg, &reg, sizeof(reg)) || cpu->sp != sp) {
+      if (retried) break;
+      retried = true;
+      passFrom = sched->now;
+      reg = cpu->reg;
+      sp = cpu->sp;
+      continue;
+    }
+
+    uint64_t pass = sched->now - passFrom;
+    uint64_t skip = sched->now < next ? (next - sched->now) / pass * pass : 0;
+    sched->now += skip;
+    idle->skipped += skip;
+    return true;
+  }
+  // leaving the loop says nothing about it
+  idle->miss = cpu->pc >= idle->from && cpu->pc <= idle->to;
+  return sched->now != from;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define IDLE_MAX_OPS 16      // longest loop looked at, in instructions
+#define IDLE_MIN_CYCLES 128  // closer events leave too little to skip
+#define IDLE_CACHE_SIZE 64   // loops looked at in rom, by pc, power of two
+
+// what IdleLoopAt found at pc, kept while the rom pages it went through stay
+// mapped
+struct idle_loop {
+  const uint8_t* pages[2];  // bus.read of from and to, NULL for none kept
+  uint16_t pc;
+  uint16_t from;
+  uint16_t to;
+  bool loop;
+};
+
+// Busy wait loops, like LDH A,(LY) / CP n / JR NZ. A loop that only reads
+// registers nothing but an event changes, writes nothing and comes back to
+// the same registers every pass can't leave before the next event, so the
+// passes up to it are skipped instead of run.
+struct idle {
+  bool off;          // run every pass, to compare against
+  bool miss;         // from-to is a loop that didn't qualify
+  uint16_t from;
+  uint16_t to;
+  uint64_t skipped;  // cycles not run
+  struct idle_loop cache[IDLE_CACHE_SIZE];
+};
+
+struct gb;
+
+// false when the cpu isn't in such a loop and nothing ran, otherwise
+// sched.now moved on by what ran and what was skipped
+bool IdleRun(struct gb* gb, uint64_t next);
+
+// after events, a loop that didn't qualify is looked at again once left
+static inline void IdleLeft(struct idle* idle, uint16_t pc) {
+  if (pc < idle->from || pc > idle->to) idle->miss = false;
+}
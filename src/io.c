@@ -0,0 +1,65 @@
+#include "io.h"
+
+#include "gb.h"
+
+// no link partner, the byte goes to gb->serial and 0xFF comes back. This is
+// how Blargg's test roms report their results.
+static void SerialEvent(struct gb* gb) {
+  uint8_t* ram = gb->ram;
+  fputc(ram[SB], gb->serial);
+  ram[SB] = 0xFF;
+  ram[SC] &= ~0x80;
+  ram[IF] |= INT_SERIAL;
+}
+
+static void DmaEvent(struct gb* gb) {
+  uint16_t from = gb->ram[DMA] << 010;
+  for (uint8_t i = 0; i < 0xA0; i++)
+    gb->ram[OAM + i] = BusRead(&gb->bus, from + i);
+}
+
+// side effects of an IO register write, addr is the register written
+void IoWrite(struct gb* gb, uint16_t addr) {
+  struct sched* sched = &gb->sched;
+
+  switch (addr) {
+    case SC:
+      if ((gb->ram[SC] & 0x81) == 0x81)
+        SchedAdd(sched, EVENT_SERIAL, sched->now + SERIAL_CYCLES);
+      break;
+    case DMA:
+      SchedAdd(sched, EVENT_DMA, sched->now + DMA_CYCLES);
+      break;
+    case LCDC:
+      PpuLcdc(gb);
+      break;
+    case LYC:
+      PpuLyc(gb);
+      break;
+    case DIV:
+    case TIMA:
+    case TAC:
+      TimerWrite(gb, addr);
+      break;
+    case BOOT:
+      if (gb->ram[BOOT]) BusMapCart(gb, 0x00, 0, 1);
+      break;
+  }
+}
+
+void IoEvent(struct gb* gb, uint8_t event) {
+  switch (event) {
+    case EVENT_PPU:
+      PpuEvent(gb);
+      break;
+    case EVENT_SERIAL:
+      SerialEvent(gb);
+      break;
+    case EVENT_DMA:
+      DmaEvent(gb);
+      break;
+    case EVENT_TIMER:
+      TimerEvent(gb);
+      break;
+  }
+}
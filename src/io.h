@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ppu.h"
+
+#define JOYP 0xFF00  // no buttons wired up, reads as all released
+
+// serial regs
+#define SB 0xFF01
+#define SC 0xFF02
+/*-SC-+-------------------+
+ |  7 | Transfer start    |
+ |  0 | Internal clock    |
+ +----+------------------*/
+#define SERIAL_CYCLES 4096  // 8 bits at 8192 Hz
+
+#define BOOT 0xFF50  // boot rom mapped while 0
+
+#define DMA_CYCLES 640  // 160 bytes, one per M-cycle
+
+struct gb;
+
+void IoWrite(struct gb* gb, uint16_t addr);
+void IoEvent(struct gb* gb, uint8_t event);
@@ -0,0 +1,218 @@
+#include "mbc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gb.h"
+#include "io.h"
+
+#define RTC_CYCLES 4194304  // one second
+
+__extension__ static uint8_t MbcTypeOf(uint8_t type) {
+  switch (type) {
+    case 0x01 ... 0x03:
+      return MBC_1;
+    case 0x0F ... 0x13:
+      return MBC_3;
+    case 0x19 ... 0x1E:
+      return MBC_5;
+  }
+  return MBC_NONE;
+}
+
+// brings the clock up to the current cycle, lazily since nothing reads it
+// unless a latch or a register write comes along
+static void MbcRtcUpdate(struct gb* gb) {
+  struct mbc* mbc = &gb->mbc;
+  uint8_t* rtc = mbc->rtc;
+  uint64_t seconds = (gb->sched.now - mbc->rtcAt) / RTC_CYCLES;
+
+  if (rtc[4] & 0x40) {
+    mbc->rtcAt = gb->sched.now;
+    return;
+  }
+  mbc->rtcAt += seconds * RTC_CYCLES;
+  for (; seconds; seconds--) {
+    if (++rtc[0] < 60) continue;
+    rtc[0] = 0;
+    if (++rtc[1] < 60) continue;
+    rtc[1] = 0;
+    if (++rtc[2] < 24) continue;
+    rtc[2] = 0;
+    if (++rtc[3]) continue;
+    if (rtc[4] & 0x01) rtc[4] |= 0x80;  // day 511 wrapped
+    rtc[4] ^= 0x01;
+  }
+}
+
+static uint8_t MbcReadOff(struct gb* gb, uint16_t addr) { return 0xFF; }
+
+static void MbcWriteOff(struct gb* gb, struct cpu* cpu, uint16_t addr,
+                        uint8_t u8) {}
+
+static uint8_t MbcReadRtc(struct gb* gb, uint16_t addr) {
+  return gb->mbc.latched[gb->mbc.ramBank - RTC_S];
+}
+
+static void MbcWriteRtc(struct gb* gb, struct cpu* cpu, uint16_t addr,
+                        uint8_t u8) {
+  struct mbc* mbc = &gb->mbc;
+
+  MbcRtcUpdate(gb);
+  mbc->rtc[mbc->ramBank - RTC_S] = u8;
+  mbc->latched[mbc->ramBank - RTC_S] = u8;
+  if (mbc->ramBank == RTC_S) mbc->rtcAt = gb->sched.now;  // second restarts
+}
+
+// repoints $4000-$7FFF
+static void MbcMapRom(struct gb* gb) {
+  struct mbc* mbc = &gb->mbc;
+  uint16_t bank = mbc->romBank;
+
+  if (mbc->type == MBC_1) bank |= mbc->ramBank << 5;
+  BusMapCart(gb, 0x40, (bank % mbc->romBanks) * ROM_BANK_SIZE, 0x40);
+}
+
+// repoints $0000-$3FFF, MBC1 in mode 1 banks it with the 2 high bits
+static void MbcMapRom0(struct gb* gb) {
+  struct mbc* mbc = &gb->mbc;
+  uint16_t bank = mbc->mode ? mbc->ramBank << 5 : 0;
+
+  BusMapCart(gb, 0x00, (bank % mbc->romBanks) * ROM_BANK_SIZE, 0x40);
+  if (!gb->ram[BOOT]) gb->bus.read[0x00] = gb->boot;
+}
+
+// repoints $A000-$BFFF at the selected ram bank, the clock or nothing. MBC3
+// keeps the whole byte written, $00-$07 are ram, $08-$0C the clock and the
+// rest reads open bus.
+static void MbcMapRam(struct gb* gb) {
+  struct mbc* mbc = &gb->mbc;
+  struct bus* bus = &gb->bus;
+  uint8_t bank = mbc->ramBank;
+  bool clock = mbc->clock && bank >= RTC_S && bank <= RTC_DH;
+  bool ram = mbc->ram && (mbc->type != MBC_3 || bank < RTC_S);
+
+  if (mbc->type == MBC_1 && !mbc->mode) bank = 0;
+  for (int i = 0; i < RAM_BANK_SIZE / BUS_PAGE_SIZE; i++) {
+    uint8_t page = 0xA0 + i;
+    if (mbc->ramEnable && clock) {
+      bus->read[page] = NULL;
+      bus->write[page] = NULL;
+      bus->reader[page] = MbcReadRtc;
+      bus->writer[page] = MbcWriteRtc;
+    } else if (mbc->ramEnable && ram) {
+      // banks past the ram wrap, 2 KiB rams repeat over the window
+      uint8_t* p = mbc->ram +
+                   (bank * RAM_BANK_SIZE + i * BUS_PAGE_SIZE) % mbc->ramSize;
+      bus->read[page] = p;
+      bus->write[page] = p;
+    } else {
+      bus->read[page] = NULL;
+      bus->write[page] = NULL;
+      bus->reader[page] = MbcReadOff;
+      bus->writer[page] = MbcWriteOff;
+    }
+  }
+}
+
+// writes to $0000-$7FFF
+static void MbcWrite(struct gb* gb, struct cpu* cpu, uint16_t addr,
+                     uint8_t u8) {
+  struct mbc* mbc = &gb->mbc;
+
+  switch (addr >> 13) {
+    case 0:  // $0000-$1FFF ram enable
+      mbc->ramEnable = (u8 & 0x0F) == 0x0A;
+      MbcMapRam(gb);
+      return;
+    case 1:  // $2000-$3FFF rom bank
+      if (mbc->type == MBC_1) {
+        mbc->romBank = (u8 & 0x1F) ? u8 & 0x1F : 1;
+      } else if (mbc->type == MBC_3) {
+        mbc->romBank = (u8 & 0x7F) ? u8 & 0x7F : 1;
+      } else if (addr < 0x3000) {
+        mbc->romBank = (mbc->romBank & 0x100) | u8;
+      } else {
+        mbc->romBank = (mbc->romBank & 0xFF) | (u8 & 0x01) << 010;
+      }
+      MbcMapRom(gb);
+      return;
+    case 2:  // $4000-$5FFF ram bank
+      if (mbc->type == MBC_1) {
+        mbc->ramBank = u8 & 0x03;
+        MbcMapRom(gb);
+        if (mbc->mode) MbcMapRom0(gb);
+      } else {
+        mbc->ramBank = mbc->type == MBC_5 ? u8 & 0x0F : u8;
+      }
+      MbcMapRam(gb);
+      return;
+    case 3:  // $6000-$7FFF
+      if (mbc->type == MBC_1) {
+        mbc->mode = u8 & 0x01;
+        MbcMapRom0(gb);
+        MbcMapRam(gb);
+      } else if (mbc->type == MBC_3) {
+        if (!mbc->latch && u8 == 0x01) {
+          MbcRtcUpdate(gb);
+          for (int i = 0; i < 5; i++) mbc->latched[i] = mbc->rtc[i];
+        }
+        mbc->latch = u8;
+      }
+      return;
+  }
+}
+
+// picks the mapper from the header and allocates the cartridge ram
+int MbcInit(struct gb* gb) {
+  static const uint32_t RamSizes[6] = {0, 0x800, 0x2000, 0x8000, 0x20000,
+                                       0x10000};
+  const struct cart* cart = gb->cart;
+  struct mbc* mbc = &gb->mbc;
+  uint8_t type = cart->size > 0x149 ? cart->data[0x147] : 0;
+  uint8_t ram = cart->size > 0x149 ? cart->data[0x149] : 0;
+
+  mbc->type = MbcTypeOf(type);
+  mbc->romBanks = (cart->size + ROM_BANK_SIZE - 1) / ROM_BANK_SIZE;
+  mbc->romBank = 1;
+  mbc->ramSize = ram < 6 ? RamSizes[ram] : 0;
+  mbc->clock = type == 0x0F || type == 0x10;
+  if (mbc->type == MBC_NONE && (type == 0x08 || type == 0x09))
+    mbc->ramEnable = true;  // no mapper to switch it on
+  if (mbc->type == MBC_NONE && type > 0x09)
+    printf("[ERROR] %s: cartridge type $%02X isn't supported\n", __func__,
+           type);
+
+  if (mbc->ramSize) {
+    mbc->ram = calloc(mbc->ramSize, 1);
+    if (!mbc->ram) {
+      printf("[ERROR] %s: no memory for the cartridge ram\n", __func__);
+      return MBC_ERROR_MEMORY;
+    }
+  }
+
+  if (mbc->type != MBC_NONE) {
+    for (int page = 0x00; page < 0x80; page++)
+      gb->bus.writer[page] = MbcWrite;
+    MbcMapRom(gb);
+  }
+  MbcMapRam(gb);
+  return MBC_OK;
+}
+
+// repoints every banked window after the mbc state was replaced as a whole
+void MbcRemap(struct gb* gb) {
+  if (gb->mbc.type != MBC_NONE) {
+    MbcMapRom(gb);
+    MbcMapRom0(gb);
+  } else {
+    BusMapCart(gb, 0x00, 0, 1);
+    if (!gb->ram[BOOT]) gb->bus.read[0x00] = gb->boot;
+  }
+  MbcMapRam(gb);
+}
+
+void MbcFree(struct gb* gb) {
+  free(gb->mbc.ram);
+  gb->mbc.ram = NULL;
+}
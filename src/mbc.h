@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MBC_OK 0
+#define MBC_ERROR_MEMORY 1
+
+// mappers, by the cartridge type in the header
+#define MBC_NONE 0
+#define MBC_1 1
+#define MBC_3 3
+#define MBC_5 5
+
+#define ROM_BANK_SIZE 0x4000
+#define RAM_BANK_SIZE 0x2000
+
+// MBC3 clock registers, selected like a RAM bank
+#define RTC_S 0x08
+#define RTC_M 0x09
+#define RTC_H 0x0A
+#define RTC_DL 0x0B
+#define RTC_DH 0x0C
+/*-DH-+-------------------+
+ |  7 | Day carry         |
+ |  6 | Halt              |
+ |  0 | Day bit 8         |
+ +----+------------------*/
+
+struct gb;
+
+// A bank switch only repoints the bus pages of the switched window, the rom
+// is never copied.
+struct mbc {
+  uint8_t type;
+  uint16_t romBanks;
+  uint16_t romBank;  // MBC1: the 5 low bits only
+  uint8_t ramBank;   // MBC1: the 2 high bits, rom or ram by mode
+  uint8_t mode;      // MBC1 banking mode
+  bool ramEnable;
+  bool clock;        // MBC3 with the timer, types $0F and $10
+  uint8_t* ram;      // cartridge ram, NULL when the cart has none
+  uint32_t ramSize;
+
+  uint8_t rtc[5];      // S M H DL DH, counting
+  uint8_t latched[5];  // what the cpu reads
+  uint64_t rtcAt;      // cycle the counters were last brought up to
+  uint8_t latch;       // last write to $6000-$7FFF
+};
+
+int MbcInit(struct gb* gb);
+void MbcRemap(struct gb* gb);
+void MbcFree(struct gb* gb);
@@ -0,0 +1,119 @@
+#include "cpu.h"
+#include "gb.h"
+#include "ops.h"
+#include "trace.h"
+
+#if CPU_ENGINE == CPU_ENGINE_TABLE
+
+static uint8_t OpPrefixCb(struct cpu* cpu, uint8_t opcode);
+
+// primary opcodes, later entries override the family ranges
+__extension__ static const CpuOp CpuOpTable[0x100] = {
+    [0x00 ... 0xFF] = OpIllegal,
+
+    // 0x00 - 0x3F by column
+    [0x00] = OpNop,
+    [0x10] = OpStop,
+    [0x08] = OpLdU16Sp,
+    [0x18] = OpJr,
+    [0x20] = OpJrCc, [0x28] = OpJrCc, [0x30] = OpJrCc, [0x38] = OpJrCc,
+    [0x01] = OpLdRpU16, [0x11] = OpLdRpU16, [0x21] = OpLdRpU16,
+    [0x31] = OpLdRpU16,
+    [0x09] = OpAddHlRp, [0x19] = OpAddHlRp, [0x29] = OpAddHlRp,
+    [0x39] = OpAddHlRp,
+    [0x02] = OpLdIndA, [0x12] = OpLdIndA, [0x22] = OpLdIndA, [0x32] = OpLdIndA,
+    [0x0A] = OpLdAInd, [0x1A] = OpLdAInd, [0x2A] = OpLdAInd, [0x3A] = OpLdAInd,
+    [0x03] = OpIncRp, [0x13] = OpIncRp, [0x23] = OpIncRp, [0x33] = OpIncRp,
+    [0x0B] = OpDecRp, [0x1B] = OpDecRp, [0x2B] = OpDecRp, [0x3B] = OpDecRp,
+    [0x04] = OpIncR8, [0x0C] = OpIncR8, [0x14] = OpIncR8, [0x1C] = OpIncR8,
+    [0x24] = OpIncR8, [0x2C] = OpIncR8, [0x34] = OpIncR8, [0x3C] = OpIncR8,
+    [0x05] = OpDecR8, [0x0D] = OpDecR8, [0x15] = OpDecR8, [0x1D] = OpDecR8,
+    [0x25] = OpDecR8, [0x2D] = OpDecR8, [0x35] = OpDecR8, [0x3D] = OpDecR8,
+    [0x06] = OpLdR8U8, [0x0E] = OpLdR8U8, [0x16] = OpLdR8U8, [0x1E] = OpLdR8U8,
+    [0x26] = OpLdR8U8, [0x2E] = OpLdR8U8, [0x36] = OpLdR8U8, [0x3E] = OpLdR8U8,
+    [0x07] = OpRotA, [0x0F] = OpRotA, [0x17] = OpRotA, [0x1F] = OpRotA,
+    [0x27] = OpDaa, [0x2F] = OpCpl, [0x37] = OpScf, [0x3F] = OpCcf,
+
+    // 0x40 - 0xBF: LD r,r and ALU A,r
+    [0x40 ... 0x7F] = OpLdR8R8,
+    [0x76] = OpHalt,
+    [0x80 ... 0xBF] = OpAluR8,
+
+    // 0xC0 - 0xFF by column
+    [0xC0] = OpRetCc, [0xC8] = OpRetCc, [0xD0] = OpRetCc, [0xD8] = OpRetCc,
+    [0xC1] = OpPop, [0xD1] = OpPop, [0xE1] = OpPop, [0xF1] = OpPop,
+    [0xC5] = OpPush, [0xD5] = OpPush, [0xE5] = OpPush, [0xF5] = OpPush,
+    [0xC2] = OpJpCc, [0xCA] = OpJpCc, [0xD2] = OpJpCc, [0xDA] = OpJpCc,
+    [0xC4] = OpCallCc, [0xCC] = OpCallCc, [0xD4] = OpCallCc, [0xDC] = OpCallCc,
+    [0xC6] = OpAluU8, [0xCE] = OpAluU8, [0xD6] = OpAluU8, [0xDE] = OpAluU8,
+    [0xE6] = OpAluU8, [0xEE] = OpAluU8, [0xF6] = OpAluU8, [0xFE] = OpAluU8,
+    [0xC7] = OpRst, [0xCF] = OpRst, [0xD7] = OpRst, [0xDF] = OpRst,
+    [0xE7] = OpRst, [0xEF] = OpRst, [0xF7] = OpRst, [0xFF] = OpRst,
+    [0xC3] = OpJp,
+    [0xC9] = OpRet,
+    [0xD9] = OpRetI,
+    [0xCB] = OpPrefixCb,
+    [0xCD] = OpCall,
+    [0xE0] = OpLdhU8A,
+    [0xF0] = OpLdhAU8,
+    [0xE2] = OpLdhCA,
+    [0xF2] = OpLdhAC,
+    [0xE8] = OpAddSpI8,
+    [0xF8] = OpLdHlSpI8,
+    [0xE9] = OpJpHl,
+    [0xF9] = OpLdSpHl,
+    [0xEA] = OpLdU16A,
+    [0xFA] = OpLdAU16,
+    [0xF3] = OpDi,
+    [0xFB] = OpEi,
+};
+
+// 0xCB prefixed opcodes
+__extension__ static const CpuOp CpuCbTable[0x100] = {
+    [0x00 ... 0x3F] = OpCbRot,
+    [0x40 ... 0x7F] = OpCbBit,
+    [0x80 ... 0xBF] = OpCbRes,
+    [0xC0 ... 0xFF] = OpCbSet,
+};
+
+static uint8_t OpPrefixCb(struct cpu* cpu, uint8_t opcode) {
+  uint8_t cb = Fetch8(cpu);
+  return CpuCbTable[cb](cpu, cb);
+}
+
+
+int CpuStep(struct gb* gb, uint8_t* cycles) {
+  struct cpu* cpu = &gb->cpu;
+  uint16_t pc = cpu->pc;
+  uint8_t opcode = Fetch8(cpu);
+
+  *cycles = CpuOpTable[opcode](cpu, opcode);
+  if (!*cycles) return CPU_ERROR_UNK_INSTRUCTION;
+
+  TRACE_STEP(gb, cpu, pc, *cycles);
+  return CPU_OK;
+}
+
+int CpuRun(struct gb* gb, uint32_t budget, uint32_t* cycles) {
+  struct cpu* cpu = &gb->cpu;
+  uint32_t ran = 0;
+
+  cpu->yield = false;
+  while (ran < budget && !cpu->hlt && !cpu->yield) {
+    uint16_t pc = cpu->pc;
+    cpu->ran = ran;
+    uint8_t opcode = Fetch8(cpu);
+    uint8_t taken = CpuOpTable[opcode](cpu, opcode);
+    if (!taken) {
+      *cycles = ran;
+      return CPU_ERROR_UNK_INSTRUCTION;
+    }
+    ran += taken;
+    TRACE_STEP(gb, cpu, pc, taken);
+  }
+
+  *cycles = ran;
+  return CPU_OK;
+}
+
+#endif
@@ -0,0 +1,534 @@
+#pragma once
+
+#include "bus.h"
+#include "cpu.h"
+#include "timer.h"
+
+// Instruction families shared by the table driven engines. Every handler
+// takes the full opcode, decodes its operands from the bit fields and
+// returns the T-cycles taken, 0 marks an unknown instruction.
+//
+//   r8 (bits 0-2 / 3-5): B C D E H L (HL) A
+//   rp (bits 4-5):       BC DE HL SP
+//   cc (bits 3-4):       NZ Z NC C
+//   alu (bits 3-5):      ADD ADC SUB SBC AND XOR OR CP
+
+typedef uint8_t (*CpuOp)(struct cpu* cpu, uint8_t opcode);
+
+#define R8_HL 6
+#define R8(r) (((uint8_t*)reg)[r])
+
+#define FLAGS(z, n, h, c) (F = (z) << 7 | (n) << 6 | (h) << 5 | (c) << 4)
+
+// an engine running on a copy of gb->cpu defines OPS_OWN_BUS and brings its
+// own Read8 and Write8, which hand gb->cpu to the bus handlers
+#ifndef OPS_OWN_BUS
+static inline uint8_t Read8(struct cpu* cpu, uint16_t addr) {
+  return BusRead(cpu->bus, addr);
+}
+
+static inline void Write8(struct cpu* cpu, uint16_t addr, uint8_t u8) {
+  BusWrite(cpu->bus, cpu, addr, u8);
+}
+#endif
+
+static inline uint8_t Fetch8(struct cpu* cpu) {
+  return Read8(cpu, cpu->pc++);
+}
+
+static inline uint16_t Fetch16(struct cpu* cpu) {
+  uint16_t u16 = Fetch8(cpu);
+  return u16 | Fetch8(cpu) << 010;
+}
+
+static inline void Push16(struct cpu* cpu, uint16_t u16) {
+  Write8(cpu, --cpu->sp, u16 >> 010);
+  Write8(cpu, --cpu->sp, u16 & 0xFF);
+}
+
+static inline uint16_t Pop16(struct cpu* cpu) {
+  uint16_t u16 = Read8(cpu, cpu->sp++);
+  return u16 | Read8(cpu, cpu->sp++) << 010;
+}
+
+static inline uint8_t GetR8(struct cpu* cpu, uint8_t r) {
+  struct Registers* reg = &cpu->reg;
+  return r == R8_HL ? Read8(cpu, HL) : R8(r);
+}
+
+static inline void SetR8(struct cpu* cpu, uint8_t r, uint8_t u8) {
+  struct Registers* reg = &cpu->reg;
+  if (r == R8_HL)
+    Write8(cpu, HL, u8);
+  else
+    R8(r) = u8;
+}
+
+static inline uint16_t GetRp(struct cpu* cpu, uint8_t p) {
+  struct Registers* reg = &cpu->reg;
+  if (p == 3) return cpu->sp;
+  return R8(p << 1) << 010 | R8((p << 1) + 1);
+}
+
+static inline void SetRp(struct cpu* cpu, uint8_t p, uint16_t u16) {
+  struct Registers* reg = &cpu->reg;
+  if (p == 3) {
+    cpu->sp = u16;
+  } else {
+    R8(p << 1) = u16 >> 010;
+    R8((p << 1) + 1) = u16 & 0xFF;
+  }
+}
+
+static inline bool Cond(struct cpu* cpu, uint8_t opcode) {
+  struct Registers* reg = &cpu->reg;
+  uint8_t cc = (opcode >> 3) & 3;
+  return ((F >> ((cc & 2) ? 4 : 7)) & 1) == (cc & 1);
+}
+
+static inline void Alu(struct cpu* cpu, uint8_t op, uint8_t u8) {
+  struct Registers* reg = &cpu->reg;
+  uint8_t carry = GET_C;
+  switch (op) {
+    case 0:  // ADD
+      carry = 0;
+      // fall through
+    case 1:  // ADC
+    {
+      uint16_t r = A + u8 + carry;
+      FLAGS(!(r & 0xFF), 0, (A & 0xF) + (u8 & 0xF) + carry > 0xF, r > 0xFF);
+      A = r;
+      break;
+    }
+    case 2:  // SUB
+    case 7:  // CP
+      carry = 0;
+      // fall through
+    case 3:  // SBC
+    {
+      uint8_t r = A - u8 - carry;
+      FLAGS(!r, 1, (A & 0xF) < (u8 & 0xF) + carry, A < u8 + carry);
+      if (op != 7) A = r;
+      break;
+    }
+    case 4:  // AND
+      A &= u8;
+      FLAGS(!A, 0, 1, 0);
+      break;
+    case 5:  // XOR
+      A ^= u8;
+      FLAGS(!A, 0, 0, 0);
+      break;
+    case 6:  // OR
+      A |= u8;
+      FLAGS(!A, 0, 0, 0);
+      break;
+  }
+}
+
+/*--------------
+ *  Loads
+ *-------------*/
+static inline uint8_t OpNop(struct cpu* cpu, uint8_t opcode) { return 4; }
+
+static inline uint8_t OpLdR8R8(struct cpu* cpu, uint8_t opcode) {
+  uint8_t dst = (opcode >> 3) & 7, src = opcode & 7;
+  SetR8(cpu, dst, GetR8(cpu, src));
+  return (dst == R8_HL || src == R8_HL) ? 8 : 4;
+}
+
+static inline uint8_t OpLdR8U8(struct cpu* cpu, uint8_t opcode) {
+  uint8_t dst = (opcode >> 3) & 7;
+  SetR8(cpu, dst, Fetch8(cpu));
+  return dst == R8_HL ? 12 : 8;
+}
+
+static inline uint8_t OpLdRpU16(struct cpu* cpu, uint8_t opcode) {
+  SetRp(cpu, opcode >> 4, Fetch16(cpu));
+  return 12;
+}
+
+// (BC) (DE) (HL+) (HL-) by bits 4-5
+static inline uint16_t IndirectAddr(struct cpu* cpu, uint8_t opcode) {
+  struct Registers* reg = &cpu->reg;
+  uint8_t p = opcode >> 4;
+  if (p < 2) return GetRp(cpu, p);
+  uint16_t addr = HL;
+  SetRp(cpu, 2, p == 2 ? addr + 1 : addr - 1);
+  return addr;
+}
+
+static inline uint8_t OpLdIndA(struct cpu* cpu, uint8_t opcode) {
+  Write8(cpu, IndirectAddr(cpu, opcode), cpu->reg.a);
+  return 8;
+}
+
+static inline uint8_t OpLdAInd(struct cpu* cpu, uint8_t opcode) {
+  cpu->reg.a = Read8(cpu, IndirectAddr(cpu, opcode));
+  return 8;
+}
+
+static inline uint8_t OpLdU16Sp(struct cpu* cpu, uint8_t opcode) {
+  uint16_t u16 = Fetch16(cpu);
+  Write8(cpu, u16, cpu->sp & 0xFF);
+  Write8(cpu, u16 + 1, cpu->sp >> 010);
+  return 20;
+}
+
+static inline uint8_t OpLdhU8A(struct cpu* cpu, uint8_t opcode) {
+  Write8(cpu, 0xFF00 + Fetch8(cpu), cpu->reg.a);
+  return 12;
+}
+
+static inline uint8_t OpLdhAU8(struct cpu* cpu, uint8_t opcode) {
+  cpu->reg.a = Read8(cpu, 0xFF00 + Fetch8(cpu));
+  return 12;
+}
+
+static inline uint8_t OpLdhCA(struct cpu* cpu, uint8_t opcode) {
+  Write8(cpu, 0xFF00 + cpu->reg.c, cpu->reg.a);
+  return 8;
+}
+
+static inline uint8_t OpLdhAC(struct cpu* cpu, uint8_t opcode) {
+  cpu->reg.a = Read8(cpu, 0xFF00 + cpu->reg.c);
+  return 8;
+}
+
+static inline uint8_t OpLdU16A(struct cpu* cpu, uint8_t opcode) {
+  Write8(cpu, Fetch16(cpu), cpu->reg.a);
+  return 16;
+}
+
+static inline uint8_t OpLdAU16(struct cpu* cpu, uint8_t opcode) {
+  cpu->reg.a = Read8(cpu, Fetch16(cpu));
+  return 16;
+}
+
+static inline uint8_t OpLdSpHl(struct cpu* cpu, uint8_t opcode) {
+  cpu->sp = GetRp(cpu, 2);
+  return 8;
+}
+
+static inline uint16_t SpOffset(struct cpu* cpu) {
+  struct Registers* reg = &cpu->reg;
+  uint8_t u8 = Fetch8(cpu);
+  FLAGS(0, 0, (cpu->sp & 0xF) + (u8 & 0xF) > 0xF,
+        (cpu->sp & 0xFF) + u8 > 0xFF);
+  return cpu->sp + (int8_t)u8;
+}
+
+static inline uint8_t OpLdHlSpI8(struct cpu* cpu, uint8_t opcode) {
+  SetRp(cpu, 2, SpOffset(cpu));
+  return 12;
+}
+
+static inline uint8_t OpPush(struct cpu* cpu, uint8_t opcode) {
+  struct Registers* reg = &cpu->reg;
+  uint8_t p = (opcode >> 4) & 3;
+  Push16(cpu, p == 3 ? AF : GetRp(cpu, p));
+  return 16;
+}
+
+static inline uint8_t OpPop(struct cpu* cpu, uint8_t opcode) {
+  struct Registers* reg = &cpu->reg;
+  uint8_t p = (opcode >> 4) & 3;
+  uint16_t u16 = Pop16(cpu);
+  if (p == 3) {
+    A = u16 >> 010;
+    F = u16 & 0xF0;
+  } else {
+    SetRp(cpu, p, u16);
+  }
+  return 12;
+}
+
+/*------------
+ *  ALU
+ *-----------*/
+static inline uint8_t OpAluR8(struct cpu* cpu, uint8_t opcode) {
+  uint8_t src = opcode & 7;
+  Alu(cpu, (opcode >> 3) & 7, GetR8(cpu, src));
+  return src == R8_HL ? 8 : 4;
+}
+
+static inline uint8_t OpAluU8(struct cpu* cpu, uint8_t opcode) {
+  Alu(cpu, (opcode >> 3) & 7, Fetch8(cpu));
+  return 8;
+}
+
+static inline uint8_t OpIncR8(struct cpu* cpu, uint8_t opcode) {
+  struct Registers* reg = &cpu->reg;
+  uint8_t r = (opcode >> 3) & 7;
+  uint8_t u8 = GetR8(cpu, r) + 1;
+  SetR8(cpu, r, u8);
+  FLAGS(!u8, 0, !(u8 & 0xF), GET_C);
+  return r == R8_HL ? 12 : 4;
+}
+
+static inline uint8_t OpDecR8(struct cpu* cpu, uint8_t opcode) {
+  struct Registers* reg = &cpu->reg;
+  uint8_t r = (opcode >> 3) & 7;
+  uint8_t u8 = GetR8(cpu, r) - 1;
+  SetR8(cpu, r, u8);
+  FLAGS(!u8, 1, (u8 & 0xF) == 0xF, GET_C);
+  return r == R8_HL ? 12 : 4;
+}
+
+static inline uint8_t OpIncRp(struct cpu* cpu, uint8_t opcode) {
+  uint8_t p = opcode >> 4;
+  SetRp(cpu, p, GetRp(cpu, p) + 1);
+  return 8;
+}
+
+static inline uint8_t OpDecRp(struct cpu* cpu, uint8_t opcode) {
+  uint8_t p = opcode >> 4;
+  SetRp(cpu, p, GetRp(cpu, p) - 1);
+  return 8;
+}
+
+static inline uint8_t OpAddHlRp(struct cpu* cpu, uint8_t opcode) {
+  struct Registers* reg = &cpu->reg;
+  uint16_t hl = HL, rp = GetRp(cpu, opcode >> 4);
+  FLAGS(GET_Z, 0, (hl & 0xFFF) + (rp & 0xFFF) > 0xFFF, hl + rp > 0xFFFF);
+  SetRp(cpu, 2, hl + rp);
+  return 8;
+}
+
+static inline uint8_t OpAddSpI8(struct cpu* cpu, uint8_t opcode) {
+  cpu->sp = SpOffset(cpu);
+  return 16;
+}
+
+/*------
+ *  Misc
+ *------*/
+static inline uint8_t OpDaa(struct cpu* cpu, uint8_t opcode) {
+  struct Registers* reg = &cpu->reg;
+  uint8_t carry = GET_C;
+  if (!GET_N) {
+    if (carry || A > 0x99) {
+      A += 0x60;
+      carry = 1;
+    }
+    if (GET_H || (A & 0x0F) > 0x09) A += 0x06;
+  } else {
+    if (carry) A -= 0x60;
+    if (GET_H) A -= 0x06;
+  }
+  FLAGS(!A, GET_N, 0, carry);
+  return 4;
+}
+
+static inline uint8_t OpCpl(struct cpu* cpu, uint8_t opcode) {
+  struct Registers* reg = &cpu->reg;
+  A = ~A;
+  SET_N;
+  SET_H;
+  return 4;
+}
+
+static inline uint8_t OpScf(struct cpu* cpu, uint8_t opcode) {
+  struct Registers* reg = &cpu->reg;
+  FLAGS(GET_Z, 0, 0, 1);
+  return 4;
+}
+
+static inline uint8_t OpCcf(struct cpu* cpu, uint8_t opcode) {
+  struct Registers* reg = &cpu->reg;
+  FLAGS(GET_Z, 0, 0, !GET_C);
+  return 4;
+}
+
+// an interrupt already pending wakes it right away, see GbIrqUpdate
+static inline uint8_t OpHalt(struct cpu* cpu, uint8_t opcode) {
+  cpu->hlt = true;
+  cpu->yield = true;
+  return 4;
+}
+
+// sleeps like HALT and resets the divider, which IoWrite does as for a DIV
+// write. Without a joypad only an interrupt ends it.
+static inline uint8_t OpStop(struct cpu* cpu, uint8_t opcode) {
+  cpu->pc++;
+  cpu->hlt = true;
+  cpu->yield = true;
+  cpu->io = DIV;
+  return 4;
+}
+
+static inline uint8_t OpDi(struct cpu* cpu, uint8_t opcode) {
+  cpu->ime = false;
+  cpu->irq = false;
+  return 4;
+}
+
+// IME is on after the next instruction, GbRun runs that one on its own
+static inline uint8_t OpEi(struct cpu* cpu, uint8_t opcode) {
+  if (!cpu->ime) {
+    cpu->ime = true;
+    cpu->ei = true;
+    cpu->yield = true;
+  }
+  return 4;
+}
+
+static inline uint8_t OpIllegal(struct cpu* cpu, uint8_t opcode) {
+  printf("[ERROR] %s: Unkown instruction 0x%02X at 0x%04hX\n", __func__,
+         opcode, (uint16_t)(cpu->pc - 1));
+  return 0;
+}
+
+/*------------------
+ *  Rotates & Shifts
+ *------------------*/
+static inline uint8_t Rot(struct cpu* cpu, uint8_t op, uint8_t u8) {
+  struct Registers* reg = &cpu->reg;
+  uint8_t carry;
+  switch (op) {
+    case 0:  // RLC
+      carry = u8 >> 7;
+      u8 = u8 << 1 | carry;
+      break;
+    case 1:  // RRC
+      carry = u8 & 1;
+      u8 = u8 >> 1 | carry << 7;
+      break;
+    case 2:  // RL
+      carry = u8 >> 7;
+      u8 = u8 << 1 | GET_C;
+      break;
+    case 3:  // RR
+      carry = u8 & 1;
+      u8 = u8 >> 1 | GET_C << 7;
+      break;
+    case 4:  // SLA
+      carry = u8 >> 7;
+      u8 = u8 << 1;
+      break;
+    case 5:  // SRA
+      carry = u8 & 1;
+      u8 = u8 >> 1 | (u8 & 0x80);
+      break;
+    case 6:  // SWAP
+      carry = 0;
+      u8 = u8 >> 4 | u8 << 4;
+      break;
+    default:  // SRL
+      carry = u8 & 1;
+      u8 = u8 >> 1;
+      break;
+  }
+  FLAGS(!u8, 0, 0, carry);
+  return u8;
+}
+
+// RLCA RRCA RLA RRA, same as the CB forms on A but Z is always cleared
+static inline uint8_t OpRotA(struct cpu* cpu, uint8_t opcode) {
+  struct Registers* reg = &cpu->reg;
+  A = Rot(cpu, opcode >> 3, A);
+  RES_Z;
+  return 4;
+}
+
+/*-------
+ *  Jumps
+ *-------*/
+static inline uint8_t OpJp(struct cpu* cpu, uint8_t opcode) {
+  cpu->pc = Fetch16(cpu);
+  return 16;
+}
+
+static inline uint8_t OpJpCc(struct cpu* cpu, uint8_t opcode) {
+  uint16_t u16 = Fetch16(cpu);
+  if (!Cond(cpu, opcode)) return 12;
+  cpu->pc = u16;
+  return 16;
+}
+
+static inline uint8_t OpJpHl(struct cpu* cpu, uint8_t opcode) {
+  cpu->pc = GetRp(cpu, 2);
+  return 4;
+}
+
+static inline uint8_t OpJr(struct cpu* cpu, uint8_t opcode) {
+  int8_t i8 = Fetch8(cpu);
+  cpu->pc += i8;
+  return 12;
+}
+
+static inline uint8_t OpJrCc(struct cpu* cpu, uint8_t opcode) {
+  int8_t i8 = Fetch8(cpu);
+  if (!Cond(cpu, opcode)) return 8;
+  cpu->pc += i8;
+  return 12;
+}
+
+static inline uint8_t OpCall(struct cpu* cpu, uint8_t opcode) {
+  uint16_t u16 = Fetch16(cpu);
+  Push16(cpu, cpu->pc);
+  cpu->pc = u16;
+  return 24;
+}
+
+static inline uint8_t OpCallCc(struct cpu* cpu, uint8_t opcode) {
+  uint16_t u16 = Fetch16(cpu);
+  if (!Cond(cpu, opcode)) return 12;
+  Push16(cpu, cpu->pc);
+  cpu->pc = u16;
+  return 24;
+}
+
+static inline uint8_t OpRst(struct cpu* cpu, uint8_t opcode) {
+  Push16(cpu, cpu->pc);
+  cpu->pc = opcode & 0x38;
+  return 16;
+}
+
+static inline uint8_t OpRet(struct cpu* cpu, uint8_t opcode) {
+  cpu->pc = Pop16(cpu);
+  return 16;
+}
+
+static inline uint8_t OpRetCc(struct cpu* cpu, uint8_t opcode) {
+  if (!Cond(cpu, opcode)) return 8;
+  cpu->pc = Pop16(cpu);
+  return 20;
+}
+
+static inline uint8_t OpRetI(struct cpu* cpu, uint8_t opcode) {
+  cpu->pc = Pop16(cpu);
+  cpu->ime = true;
+  cpu->yield = true;
+  return 16;
+}
+
+/*---- PREF 0xCB ---------------------------------
+ *  opcode is the byte following the prefix, cycles
+ *  include the prefix fetch
+ *------------------------------------------------*/
+static inline uint8_t OpCbRot(struct cpu* cpu, uint8_t opcode) {
+  uint8_t r = opcode & 7;
+  SetR8(cpu, r, Rot(cpu, (opcode >> 3) & 7, GetR8(cpu, r)));
+  return r == R8_HL ? 16 : 8;
+}
+
+static inline uint8_t OpCbBit(struct cpu* cpu, uint8_t opcode) {
+  struct Registers* reg = &cpu->reg;
+  uint8_t r = opcode & 7;
+  uint8_t u8 = GetR8(cpu, r);
+  FLAGS(!(u8 & (1 << ((opcode >> 3) & 7))), 0, 1, GET_C);
+  return r == R8_HL ? 12 : 8;
+}
+
+static inline uint8_t OpCbRes(struct cpu* cpu, uint8_t opcode) {
+  uint8_t r = opcode & 7;
+  SetR8(cpu, r, GetR8(cpu, r) & ~(1 << ((opcode >> 3) & 7)));
+  return r == R8_HL ? 16 : 8;
+}
+
+static inline uint8_t OpCbSet(struct cpu* cpu, uint8_t opcode) {
+  uint8_t r = opcode & 7;
+  SetR8(cpu, r, GetR8(cpu, r) | 1 << ((opcode >> 3) & 7));
+  return r == R8_HL ? 16 : 8;
+}
@@ -0,0 +1,78 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "pacer.h"
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+static uint64_t PacerNow(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+// cycles to ns without overflowing for a few centuries
+static uint64_t PacerNs(const struct pacer* pacer, uint64_t cycles) {
+  uint64_t rate = (uint64_t)pacer->hz * pacer->speed;
+  return cycles / rate * 1000000000ull + cycles % rate * 1000000000ull / rate;
+}
+
+void PacerInit(struct pacer* pacer, uint32_t hz) {
+  memset(pacer, 0, sizeof(*pacer));
+  pacer->hz = hz;
+  pacer->speed = 1;
+  pacer->start = PacerNow();
+}
+
+// the timeline restarts so cycles is due now at the new speed
+void PacerSpeed(struct pacer* pacer, uint32_t speed, uint64_t cycles) {
+  pacer->speed = speed;
+  if (speed) pacer->start = PacerNow() - PacerNs(pacer, cycles);
+}
+
+void PacerWait(struct pacer* pacer, uint64_t cycles) {
+  if (!pacer->speed) return;
+
+  uint64_t deadline = pacer->start + PacerNs(pacer, cycles);
+  uint64_t now = PacerNow();
+
+  if (now > deadline + PACER_RESYNC_NS) {
+    // a debugger stop or a stall, catching up would run flat out for a while
+    pacer->start = now - PacerNs(pacer, cycles);
+    pacer->resyncs++;
+    return;
+  }
+  if (now >= deadline) {
+    pacer->late++;
+  } else if (deadline - now > PACER_SPIN_NS) {
+    uint64_t wake = deadline - PACER_SPIN_NS;
+    struct timespec at = {.tv_sec = wake / 1000000000ull,
+                          .tv_nsec = wake % 1000000000ull};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &at, NULL) ==
+           EINTR) {
+    }
+  }
+  while ((now = PacerNow()) < deadline) {
+  }
+
+  int64_t jitter = now - deadline;
+  pacer->waits++;
+  pacer->jitterSum += jitter;
+  pacer->jitterSquares += (double)jitter * jitter;
+  if (jitter > pacer->jitterMax) pacer->jitterMax = jitter;
+}
+
+void PacerPrint(const struct pacer* pacer, FILE* out) {
+  if (!pacer->waits) return;
+
+  double mean = pacer->jitterSum / pacer->waits;
+  double deviation = sqrt(pacer->jitterSquares / pacer->waits - mean * mean);
+  fprintf(out,
+          "[INFO] %llu frames paced, jitter mean %.1f us, deviation %.1f us, "
+          "max %.1f us, %llu late, %llu resyncs\n",
+          (unsigned long long)pacer->waits, mean / 1e3, deviation / 1e3,
+          pacer->jitterMax / 1e3, (unsigned long long)pacer->late,
+          (unsigned long long)pacer->resyncs);
+}
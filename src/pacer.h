@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define PACER_SPIN_NS 200000      // the last stretch before a deadline spins
+#define PACER_RESYNC_NS 100000000  // further behind than this starts over
+#define PACER_SPEED_MAX 1000       // times real time, ns math stays in range
+
+// Real time pacing of emulated cycles on CLOCK_MONOTONIC. Every deadline is
+// computed from the start and the cycles run so far, so sleeping late never
+// adds up to drift. Waits sleep to just before the deadline with an absolute
+// clock_nanosleep and spin the rest.
+struct pacer {
+  uint32_t hz;     // emulated cycles per second
+  uint32_t speed;  // times real time, 0 doesn't wait at all
+  uint64_t start;  // ns, when cycle 0 was due
+
+  // how late each wait woke up, ns
+  uint64_t waits;
+  uint64_t late;     // deadline already passed when waited for
+  uint64_t resyncs;  // too far behind, started over
+  int64_t jitterMax;
+  double jitterSum;
+  double jitterSquares;
+};
+
+void PacerInit(struct pacer* pacer, uint32_t hz);
+
+// from cycles on run at speed times real time, 0 for as fast as it goes
+void PacerSpeed(struct pacer* pacer, uint32_t speed, uint64_t cycles);
+
+// returns once cycles are due
+void PacerWait(struct pacer* pacer, uint64_t cycles);
+
+void PacerPrint(const struct pacer* pacer, FILE* out);
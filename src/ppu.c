@@ -0,0 +1,271 @@
+#include "ppu.h"
+
+#include <string.h>
+
+#include "frames.h"
+#include "gb.h"
+
+// STAT interrupt enable bit for entering each mode, transfer has none
+static const uint8_t StatModeInt[4] = {0x08, 0x10, 0x20, 0x00};
+
+static void PpuMode(struct ppu* ppu, uint8_t* ram, uint8_t mode) {
+  ppu->mode = mode;
+  ram[STAT] = (ram[STAT] & ~0x03) | mode;
+  if (ram[STAT] & StatModeInt[mode]) ram[IF] |= INT_STAT;
+}
+
+static void PpuLine(uint8_t* ram, uint8_t line) {
+  ram[LY] = line;
+  if (line == ram[LYC]) {
+    ram[STAT] |= 0x04;
+    if (CHECK_BIT(6, ram[STAT])) ram[IF] |= INT_STAT;
+  } else {
+    ram[STAT] &= ~0x04;
+  }
+}
+
+// tile data writes, the tile is decoded again before it's drawn next
+static void PpuWriteVram(struct gb* gb, struct cpu* cpu, uint16_t addr,
+                         uint8_t u8) {
+  uint16_t tile = (addr - VRAM) >> 4;
+
+  gb->ram[addr] = u8;
+  gb->ppu.dirty[tile >> 6] |= 1ull << (tile & 63);
+}
+
+void PpuTilesUpdate(struct gb* gb) {
+  struct ppu* ppu = &gb->ppu;
+
+  for (int i = 0; i < TILE_COUNT / 64; i++) {
+    while (ppu->dirty[i]) {
+      uint16_t tile = i * 64 + __builtin_ctzll(ppu->dirty[i]);
+      ppu->decode(gb->ram + VRAM + tile * 16, ppu->tiles[tile]);
+      ppu->dirty[i] &= ppu->dirty[i] - 1;
+    }
+  }
+}
+
+// the first 10 sprites on line LY in OAM order, sorted by x so the first one
+// drawn on a pixel wins. Equal x stay in OAM order.
+static void PpuOamScan(struct gb* gb) {
+  const uint8_t* ram = gb->ram;
+  struct ppu* ppu = &gb->ppu;
+  uint8_t height = CHECK_BIT(2, ram[LCDC]) ? 16 : 8;
+
+  ppu->spriteCount = 0;
+  for (int i = 0; i < SPRITE_COUNT && ppu->spriteCount < SPRITES_PER_LINE;
+       i++) {
+    const uint8_t* oam = ram + OAM + i * 4;
+    if ((uint8_t)(ram[LY] + 16 - oam[0]) >= height) continue;
+
+    int j = ppu->spriteCount++;
+    for (; j && ram[OAM + ppu->sprites[j - 1] * 4 + 1] > oam[1]; j--)
+      ppu->sprites[j] = ppu->sprites[j - 1];
+    ppu->sprites[j] = i;
+  }
+}
+
+// pixels from to end from one row of a tile map, starting at map column x
+static void PpuRenderTiles(const struct ppu* ppu, const uint8_t* tiles,
+                           bool tiles8000, uint8_t x, uint8_t y,
+                           const uint8_t shades[4], uint8_t* line,
+                           uint8_t* colors, int from, int end) {
+  // a tile row at a time, the first and the last one partially
+  for (int i = from; i < end; x = (x | 7) + 1) {
+    uint8_t tile = tiles[x >> 3];
+    uint16_t id = tiles8000 ? tile : 256 + (int8_t)tile;
+    const uint8_t* row = ppu->tiles[id][y & 7];
+    for (int px = x & 7; px < 8 && i < end; px++, i++) {
+      colors[i] = row[px];
+      line[i] = shades[row[px]];
+    }
+  }
+}
+
+// the background up to WX and the window from there, shades to line and
+// color indices to colors, every pixel once
+static void PpuRenderBackground(struct gb* gb, uint8_t* line,
+                                uint8_t* colors) {
+  const uint8_t* ram = gb->ram;
+  struct ppu* ppu = &gb->ppu;
+  uint8_t bgp = ram[BGP];
+  const uint8_t shades[4] = {bgp & 0x03, bgp >> 2 & 0x03, bgp >> 4 & 0x03,
+                             bgp >> 6};
+  bool tiles8000 = CHECK_BIT(4, ram[LCDC]);
+
+  int wx = ram[WX] - 7;
+  int split = DISPLAY_WIDTH;
+  if (CHECK_BIT(5, ram[LCDC]) && ppu->windowY && wx < DISPLAY_WIDTH)
+    split = wx < 0 ? 0 : wx;
+
+  uint8_t y = ram[LY] + ram[SCY];
+  uint16_t map = CHECK_BIT(3, ram[LCDC]) ? TILE_MAP_9C00 : TILE_MAP_9800;
+  PpuRenderTiles(ppu, ram + map + (y >> 3) * 32, tiles8000, ram[SCX], y,
+                 shades, line, colors, 0, split);
+  if (split == DISPLAY_WIDTH) return;
+
+  y = ppu->windowLine++;
+  map = CHECK_BIT(6, ram[LCDC]) ? TILE_MAP_9C00 : TILE_MAP_9800;
+  PpuRenderTiles(ppu, ram + map + (y >> 3) * 32, tiles8000, split - wx, y,
+                 shades, line, colors, split, DISPLAY_WIDTH);
+}
+
+// the sprites the OAM search found, in priority order. A pixel goes to the
+// first opaque sprite on it, even when that one is behind the background.
+static void PpuRenderSprites(struct gb* gb, uint8_t* line,
+                             const uint8_t* colors) {
+  const uint8_t* ram = gb->ram;
+  struct ppu* ppu = &gb->ppu;
+  bool tall = CHECK_BIT(2, ram[LCDC]);
+  const uint8_t palettes[2] = {ram[OBP0], ram[OBP1]};
+  bool taken[DISPLAY_WIDTH] = {false};
+
+  for (int s = 0; s < ppu->spriteCount; s++) {
+    const uint8_t* oam = ram + OAM + ppu->sprites[s] * 4;
+    uint8_t attr = oam[3];
+    uint8_t y = ram[LY] + 16 - oam[0];
+    uint8_t tile = tall ? oam[2] & 0xFE : oam[2];
+    if (CHECK_BIT(6, attr)) y = (tall ? 15 : 7) - y;
+
+    const uint8_t* row = ppu->tiles[tile + (y >> 3 & 1)][y & 7];
+    uint8_t palette = palettes[CHECK_BIT(4, attr)];
+    bool flip = CHECK_BIT(5, attr);
+    bool behind = CHECK_BIT(7, attr);
+
+    for (int px = 0; px < 8; px++) {
+      int x = oam[1] - 8 + px;
+      uint8_t color = row[flip ? 7 - px : px];
+      if (x < 0 || x >= DISPLAY_WIDTH || !color || taken[x]) continue;
+      taken[x] = true;
+      if (!behind || !colors[x]) line[x] = palette >> (color << 1) & 0x03;
+    }
+  }
+}
+
+// line LY, drawn in one go when its transfer ends. The palettes are applied
+// here so writes between lines show up.
+static void PpuRenderLine(struct gb* gb) {
+  const uint8_t* ram = gb->ram;
+  uint8_t* line = gb->ppu.frame[ram[LY]];
+  uint8_t colors[DISPLAY_WIDTH];  // background color indices, for priority
+
+  PpuTilesUpdate(gb);
+  if (CHECK_BIT(0, ram[LCDC])) {
+    PpuRenderBackground(gb, line, colors);
+  } else {
+    memset(line, 0, DISPLAY_WIDTH);
+    memset(colors, 0, DISPLAY_WIDTH);
+  }
+  if (CHECK_BIT(1, ram[LCDC])) PpuRenderSprites(gb, line, colors);
+}
+
+static void PpuStart(struct gb* gb) {
+  gb->ppu.windowY = false;
+  gb->ppu.windowLine = 0;
+  PpuLine(gb->ram, 0);
+  PpuMode(&gb->ppu, gb->ram, MODE_OAM);
+  SchedAdd(&gb->sched, EVENT_PPU, gb->sched.now + OAM_CYCLES);
+}
+
+void PpuInit(struct gb* gb) {
+  for (int page = VRAM >> 010; page < (VRAM + TILE_COUNT * 16) >> 010;
+       page++) {
+    gb->bus.write[page] = NULL;
+    gb->bus.writer[page] = PpuWriteVram;
+  }
+  gb->ppu.frame = gb->ppu.screen;
+  gb->ppu.decode = TileDecoderBest();
+  memset(gb->ppu.dirty, 0xFF, sizeof(gb->ppu.dirty));
+
+  gb->ppu.mode = MODE_HBLANK;
+  gb->ram[LY] = 0;
+  if (CHECK_BIT(7, gb->ram[LCDC])) PpuStart(gb);
+}
+
+// finished frames go to frames from the next VBlank on, NULL detaches
+void PpuAttach(struct gb* gb, struct frames* frames) {
+  gb->ppu.out = frames;
+  gb->ppu.frame = frames ? frames->buffers[frames->back] : gb->ppu.screen;
+}
+
+// one event per mode change, rescheduled from its own due time so a late
+// dispatch doesn't drift the frame
+void PpuEvent(struct gb* gb) {
+  struct ppu* ppu = &gb->ppu;
+  uint8_t* ram = gb->ram;
+  uint64_t at = gb->sched.at[EVENT_PPU];
+
+  switch (ppu->mode) {
+    case MODE_OAM:
+      // every line, drawn or not, the window shows from the first WY match
+      if (ram[LY] == ram[WY]) ppu->windowY = true;
+      if (!ppu->skip) PpuOamScan(gb);
+      PpuMode(ppu, ram, MODE_TRANSFER);
+      at += TRANSFER_CYCLES;
+      break;
+    case MODE_TRANSFER:
+      if (!ppu->skip) PpuRenderLine(gb);
+      PpuMode(ppu, ram, MODE_HBLANK);
+      at += HBLANK_CYCLES;
+      break;
+    case MODE_HBLANK:
+      PpuLine(ram, ram[LY] + 1);
+      if (ram[LY] == DISPLAY_HEIGHT) {
+        PpuMode(ppu, ram, MODE_VBLANK);
+        ram[IF] |= INT_VBLANK;
+        if (ppu->out && !ppu->skip) {
+          FramesPublish(ppu->out);
+          ppu->frame = ppu->out->buffers[ppu->out->back];
+        }
+        ppu->frames++;
+        ppu->skip = ppu->frames % (ppu->frameSkip + 1);
+        ppu->windowY = false;
+        ppu->windowLine = 0;
+        at += LINE_CYCLES;
+      } else {
+        PpuMode(ppu, ram, MODE_OAM);
+        at += OAM_CYCLES;
+      }
+      break;
+    case MODE_VBLANK:
+      if (ram[LY] + 1 == FRAME_LINES) {
+        PpuLine(ram, 0);
+        PpuMode(ppu, ram, MODE_OAM);
+        at += OAM_CYCLES;
+      } else {
+        PpuLine(ram, ram[LY] + 1);
+        at += LINE_CYCLES;
+      }
+      break;
+  }
+  SchedAdd(&gb->sched, EVENT_PPU, at);
+}
+
+// LCDC was written, bit 7 starts the PPU at line 0 or stops it
+void PpuLcdc(struct gb* gb) {
+  bool on = CHECK_BIT(7, gb->ram[LCDC]);
+
+  if (on && !SchedPending(&gb->sched, EVENT_PPU)) {
+    PpuStart(gb);
+  } else if (!on && SchedPending(&gb->sched, EVENT_PPU)) {
+    SchedCancel(&gb->sched, EVENT_PPU);
+    gb->ppu.mode = MODE_HBLANK;
+    gb->ram[LY] = 0;
+    gb->ram[STAT] &= ~0x03;
+  }
+}
+
+// LYC was written, compared again right away instead of at the next line. The
+// interrupt only comes when the flag goes up.
+void PpuLyc(struct gb* gb) {
+  uint8_t* ram = gb->ram;
+  bool was = ram[STAT] & 0x04;
+
+  if (!SchedPending(&gb->sched, EVENT_PPU)) return;
+  if (ram[LY] != ram[LYC]) {
+    ram[STAT] &= ~0x04;
+  } else if (!was) {
+    ram[STAT] |= 0x04;
+    if (CHECK_BIT(6, ram[STAT])) ram[IF] |= INT_STAT;
+  }
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "tile.h"
+
+// GB screen buffer
+#define DISPLAY_WIDTH 160
+#define DISPLAY_HEIGHT 144
+
+// one line is OAM search, pixel transfer and H-Blank, then 10 V-Blank lines
+#define OAM_CYCLES 80
+#define TRANSFER_CYCLES 172
+#define HBLANK_CYCLES 204
+#define LINE_CYCLES (OAM_CYCLES + TRANSFER_CYCLES + HBLANK_CYCLES)
+#define FRAME_LINES 154
+#define FRAME_CYCLES (LINE_CYCLES * FRAME_LINES)  // 70224
+
+#define MODE_HBLANK 0
+#define MODE_VBLANK 1
+#define MODE_OAM 2
+#define MODE_TRANSFER 3
+
+// LCD regs
+#define LCDC 0xFF40
+/*-LCDC-+----------------------------+----- 0 ----+--------- 1 ---------+
+ |  7   | R/W LCD Enable             | No picture | opertation          |
+ |  6   | R/W Window Tile Map Sel    | 9800-9BFF  | 9C00-9FFF           |
+ |  5   | R/W Window Display         | off        | on                  |
+ |  4   | R/W BG & Win Tile Data Sel | 8800-97FF  | 8000-8FFF (overlap) |
+ |  3   | R/W BG Tile Map Select     | 9800-9BFF  | 9C00-9FFF           |
+ |  2   | R/W OBJ (Sprite) Size      | 8 x 8      | 8 x 16 (w x h)      |
+ |  1   | R/W OBJ (Sprite) Display   | off        | on                  |
+ |  0   | R/W BG & Window Display    | off        | on                  |
+ +------+----------------------------+------------+--------------------*/
+
+#define STAT 0xFF41
+/*-STAT-+---------------------+-----------------------------------------+
+ |  6   | Int Status for LCDC | LYC == LY (Selectable)                  |
+ |  5   | R/W                 | Mode 10                                 |
+ |  4   |                     | Mode 01                                 |
+ |  3   |                     | Mode 00                                 |
+ |  2   |    Coincidence Flag | LYC == (LCDC) LY                        |
+ | 1-0  | R  Mode Flag        | 00: During H-Blank                      |
+ |      |                     | 01: During V-Blank                      |
+ |      |                     | 10: During Searching OAM-RAM            |
+ |      |                     | 11: During Transferring Data to LCD Drv |
+ +------+---------------------+----------------------------------------*/
+
+#define SCY 0xFF42
+#define SCX 0xFF43
+#define LY 0xFF44
+#define LYC 0xFF45
+#define DMA 0xFF46
+#define BGP 0xFF47
+/*-BGP-+------------+
+ | 7-6 | Black 0b00 |
+ | 5-4 | Dark  0b10 |
+ | 3-2 | Light 0b01 |
+ | 1-0 | White 0b11 |
+ +-----+-----------*/
+#define OBP0 0xFF48  // as BGP, color 0 is transparent
+#define OBP1 0xFF49
+#define WY 0xFF4A  // window top left corner
+#define WX 0xFF4B  // plus 7, above 166 hides it
+
+// sprites, 4 bytes each in OAM
+#define OAM 0xFE00
+/*-OAM-+------------------------+
+ |  0  | Y + 16                 |
+ |  1  | X + 8                  |
+ |  2  | Tile, from $8000       |
+ |  3  | Attributes             |
+ +-----+------------------------+
+ |  7  | Behind BG colors 1-3   |
+ |  6  | Y flip                 |
+ |  5  | X flip                 |
+ |  4  | OBP1                   |
+ +-----+-----------------------*/
+#define SPRITE_COUNT 40
+#define SPRITES_PER_LINE 10
+
+// tile maps, LCDC selects which. The tile data is tiles 0-255 from $8000 or
+// -128-127 around $9000.
+#define TILE_MAP_9800 0x9800
+#define TILE_MAP_9C00 0x9C00
+
+#define VRAM 0x8000
+#define TILE_COUNT 384  // $8000-$97FF, 16 bytes each
+
+struct ppu {
+  // Machine state up to frameSkip, a save state copies it as is. The rest is
+  // set up by the host or rebuilt from VRAM.
+  uint8_t mode;
+  uint32_t frames;  // completed frames
+  bool skip;        // this frame is left out, see frameSkip
+
+  // OAM indices of the sprites on this line, found by the OAM search and in
+  // drawing priority order
+  uint8_t sprites[SPRITES_PER_LINE];
+  uint8_t spriteCount;
+
+  // the window starts on the first line where LY == WY and then draws its
+  // own lines, counted only on lines it showed on
+  bool windowY;
+  uint8_t windowLine;
+
+  // frames left out after each drawn one, those only keep LY and STAT going
+  // and aren't handed to frames
+  uint8_t frameSkip;
+
+  // Lines are drawn into frame, shades 0-3 where 0 is white. With a frames
+  // buffer attached that's its back buffer and handed over at VBlank,
+  // otherwise screen.
+  uint8_t (*frame)[DISPLAY_WIDTH];
+  struct frames* out;
+  uint8_t screen[DISPLAY_HEIGHT][DISPLAY_WIDTH];
+
+  // Every tile decoded to a color index per pixel. VRAM writes through the
+  // bus mark their tile dirty, PpuTilesUpdate decodes those again.
+  TileDecoder decode;
+  uint64_t dirty[TILE_COUNT / 64];
+  uint8_t tiles[TILE_COUNT][8][8];
+};
+
+struct gb;
+struct frames;
+
+void PpuInit(struct gb* gb);
+void PpuAttach(struct gb* gb, struct frames* frames);
+void PpuEvent(struct gb* gb);
+void PpuLcdc(struct gb* gb);
+void PpuLyc(struct gb* gb);
+void PpuTilesUpdate(struct gb* gb);
@@ -0,0 +1,215 @@
+#include "rewind.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gb.h"
+#include "snap.h"
+
+// Encoded state: runs of a 32 bit header, words to skip in the low half and
+// words that follow in the high half, then those words XORed with the
+// reference. Words are copied with memcpy as runs only keep 4 byte alignment.
+#define REWIND_RUN_MAX 0xFFFF
+
+static size_t RewindEncode(uint8_t* out, const uint64_t* state,
+                           const uint64_t* ref, size_t words) {
+  uint8_t* p = out;
+
+  for (size_t i = 0; i < words;) {
+    uint32_t skip = 0, copy = 0;
+    while (i < words && skip < REWIND_RUN_MAX &&
+           state[i] == (ref ? ref[i] : 0)) {
+      i++;
+      skip++;
+    }
+    while (i + copy < words && copy < REWIND_RUN_MAX &&
+           state[i + copy] != (ref ? ref[i + copy] : 0))
+      copy++;
+
+    uint32_t run = skip | copy << 16;
+    memcpy(p, &run, sizeof(run));
+    p += sizeof(run);
+    for (uint32_t j = 0; j < copy; j++, i++, p += 8) {
+      uint64_t word = state[i] ^ (ref ? ref[i] : 0);
+      memcpy(p, &word, 8);
+    }
+  }
+  return p - out;
+}
+
+// state holds the reference already, the encoded words are XORed into it
+static void RewindDecode(uint64_t* state, const uint8_t* in, size_t size) {
+  const uint8_t* end = in + size;
+  size_t i = 0;
+
+  while (in < end) {
+    uint32_t run;
+    memcpy(&run, in, sizeof(run));
+    in += sizeof(run);
+    i += run & REWIND_RUN_MAX;
+    for (uint32_t j = 0; j < run >> 16; j++, i++, in += 8) {
+      uint64_t word;
+      memcpy(&word, in, 8);
+      state[i] ^= word;
+    }
+  }
+}
+
+static struct rewind_entry* RewindEntry(struct rewind* rewind, uint32_t seq) {
+  return &rewind->entries[seq % rewind->slots];
+}
+
+static void RewindDropOldest(struct rewind* rewind) {
+  struct rewind_entry* e = RewindEntry(rewind, rewind->first);
+
+  rewind->used -= e->size;
+  rewind->first++;
+  if (--rewind->count)
+    rewind->tail = RewindEntry(rewind, rewind->first)->offset;
+  else
+    rewind->head = rewind->tail = 0;
+}
+
+// the oldest keyframe and its deltas
+static void RewindDropGroup(struct rewind* rewind) {
+  do {
+    RewindDropOldest(rewind);
+  } while (rewind->count && !RewindEntry(rewind, rewind->first)->key);
+}
+
+// Finds size bytes for the next state and a free entry, dropping the oldest
+// groups. A delta can't have its own keyframe dropped, false when that's what
+// it would take.
+static bool RewindRoom(struct rewind* rewind, size_t size, bool key) {
+  if (size > rewind->capacity) return false;
+  for (;;) {
+    bool slot = rewind->count < rewind->slots;
+    if (slot && !rewind->count) {
+      rewind->head = rewind->tail = 0;
+      return true;
+    }
+    if (slot && rewind->head > rewind->tail) {
+      if (rewind->head + size <= rewind->capacity) return true;
+      if (size <= rewind->tail) {
+        rewind->head = 0;  // the rest of the ring stays unused this round
+        return true;
+      }
+    } else if (slot && rewind->head + size <= rewind->tail) {
+      return true;
+    }
+    if (!key && rewind->first == rewind->lastKey) return false;
+    RewindDropGroup(rewind);
+  }
+}
+
+// key is decoded again from the newest keyframe left, after a rewind past it
+static void RewindRekey(struct rewind* rewind) {
+  uint32_t seq = rewind->first + rewind->count;
+
+  rewind->stale = false;
+  rewind->sinceKey = 0;
+  while (seq-- != rewind->first) {
+    struct rewind_entry* e = RewindEntry(rewind, seq);
+    if (!e->key) continue;
+    memset(rewind->key, 0, rewind->words * 8);
+    RewindDecode(rewind->key, rewind->ring + e->offset, e->size);
+    rewind->lastKey = seq;
+    rewind->sinceKey = rewind->first + rewind->count - seq;
+    return;
+  }
+}
+
+int RewindInit(struct rewind* rewind, const struct gb* gb, uint32_t interval,
+               uint32_t states, size_t bytes) {
+  size_t size = SnapSize(gb);
+
+  memset(rewind, 0, sizeof(*rewind));
+  rewind->interval = interval ? interval : 1;
+  rewind->words = size / 8;
+  // a state may end up one run header every word pair, keyframes a few more
+  rewind->state = malloc(size);
+  rewind->key = malloc(size);
+  rewind->packed = malloc(size + (rewind->words / 2 + 2) * 4);
+  rewind->ring = malloc(bytes);
+  rewind->capacity = bytes;
+  rewind->slots = states + REWIND_KEY_EVERY;
+  rewind->entries = calloc(rewind->slots, sizeof(*rewind->entries));
+  if (!rewind->state || !rewind->key || !rewind->packed || !rewind->ring ||
+      !rewind->entries) {
+    printf("[ERROR] %s: no memory for the rewind buffer\n", __func__);
+    RewindFree(rewind);
+    return REWIND_ERROR_MEMORY;
+  }
+  return REWIND_OK;
+}
+
+void RewindFree(struct rewind* rewind) {
+  free(rewind->state);
+  free(rewind->key);
+  free(rewind->packed);
+  free(rewind->ring);
+  free(rewind->entries);
+  memset(rewind, 0, sizeof(*rewind));
+}
+
+void RewindFrame(struct rewind* rewind, const struct gb* gb) {
+  if (++rewind->frames < rewind->interval) return;
+  rewind->frames = 0;
+  RewindPush(rewind, gb);
+}
+
+void RewindPush(struct rewind* rewind, const struct gb* gb) {
+  if (rewind->stale) RewindRekey(rewind);
+  SnapSave(gb, (uint8_t*)rewind->state);
+
+  bool key = !rewind->sinceKey || rewind->sinceKey >= REWIND_KEY_EVERY;
+  size_t size = RewindEncode(rewind->packed, rewind->state,
+                             key ? NULL : rewind->key, rewind->words);
+  if (!RewindRoom(rewind, size, key)) {
+    // its keyframe is in the way, it becomes one itself
+    while (rewind->count) RewindDropGroup(rewind);
+    key = true;
+    size = RewindEncode(rewind->packed, rewind->state, NULL, rewind->words);
+    if (!RewindRoom(rewind, size, key)) return;
+  }
+
+  uint32_t seq = rewind->first + rewind->count;
+  *RewindEntry(rewind, seq) =
+      (struct rewind_entry){.offset = rewind->head, .size = size, .key = key};
+  memcpy(rewind->ring + rewind->head, rewind->packed, size);
+  if (!rewind->count) rewind->tail = rewind->head;
+  rewind->head += size;
+  rewind->used += size;
+  rewind->count++;
+
+  if (key) {
+    memcpy(rewind->key, rewind->state, rewind->words * 8);
+    rewind->lastKey = seq;
+    rewind->sinceKey = 0;
+  }
+  rewind->sinceKey++;
+}
+
+bool RewindStep(struct rewind* rewind, struct gb* gb) {
+  if (!rewind->count) return false;
+  if (rewind->stale) RewindRekey(rewind);
+
+  uint32_t seq = rewind->first + rewind->count - 1;
+  struct rewind_entry* e = RewindEntry(rewind, seq);
+  if (e->key)
+    memset(rewind->state, 0, rewind->words * 8);
+  else
+    memcpy(rewind->state, rewind->key, rewind->words * 8);
+  RewindDecode(rewind->state, rewind->ring + e->offset, e->size);
+
+  // the newest state was the last written, its room is the next one's
+  rewind->head = e->offset;
+  rewind->used -= e->size;
+  if (!--rewind->count) rewind->head = rewind->tail = 0;
+  rewind->sinceKey--;
+  rewind->stale = e->key;
+  rewind->frames = 0;
+
+  return SnapLoad(gb, (uint8_t*)rewind->state, rewind->words * 8) == SNAP_OK;
+}
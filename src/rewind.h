@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define REWIND_OK 0
+#define REWIND_ERROR_MEMORY 1
+
+#define REWIND_KEY_EVERY 60  // states from one keyframe to the next
+
+// One stored state, a keyframe or a delta against the keyframe before it.
+struct rewind_entry {
+  uint32_t offset;  // in ring
+  uint32_t size;
+  bool key;
+};
+
+// Rewind buffer. Every interval frames the machine is saved (see snap.h) and
+// XORed against the last keyframe, runs of unchanged words are left out and
+// the rest stored, keyframes are stored the same way against nothing. States
+// go through a byte ring one after the other, the oldest keyframe is dropped
+// together with its deltas whenever room or an entry is needed.
+struct rewind {
+  uint32_t interval;  // frames between states
+  uint32_t frames;    // since the last state
+  size_t words;       // state size in 8 byte words, fixed by RewindInit
+
+  uint64_t* state;  // one state being saved or restored
+  uint64_t* key;    // the newest keyframe, decoded
+  uint8_t* packed;  // one encoded state, at its worst
+  bool stale;       // key was rewound past, decoded again when needed
+  uint32_t sinceKey;  // states from the newest keyframe on, itself included
+
+  uint8_t* ring;
+  size_t capacity;
+  size_t head;  // where the next state goes
+  size_t tail;  // the oldest state
+  size_t used;  // bytes in live states
+
+  // entries by sequence number modulo slots
+  struct rewind_entry* entries;
+  uint32_t slots;
+  uint32_t first;  // sequence number of the oldest state
+  uint32_t count;
+  uint32_t lastKey;  // sequence number of the newest keyframe
+};
+
+struct gb;
+
+// room for states states of gb in bytes, one every interval frames
+int RewindInit(struct rewind* rewind, const struct gb* gb, uint32_t interval,
+               uint32_t states, size_t bytes);
+void RewindFree(struct rewind* rewind);
+
+// once a frame between GbRun calls, stores a state every interval frames
+void RewindFrame(struct rewind* rewind, const struct gb* gb);
+void RewindPush(struct rewind* rewind, const struct gb* gb);
+
+// loads the newest state and forgets it, false when there is none left
+bool RewindStep(struct rewind* rewind, struct gb* gb);
@@ -1,7 +1,7 @@
 #include "rom.h"
 
-__extension__ void PrintRomType(uint8_t* ram) {
-  uint8_t type = ram[0x0147];
+__extension__ void PrintRomType(const uint8_t* rom) {
+  uint8_t type = rom[0x0147];
   static const char* CartridgeTypes[0x100] = {
       "ROM ONLY",
       "ROM + MBC1",
@@ -38,8 +38,8 @@ __extension__ void PrintRomType(uint8_t* ram) {
   printf("[INFO] ROM TYPE: %s\n", CartridgeTypes[type]);
 }
 
-__extension__ void PrintRomSize(uint8_t* ram) {
-  uint8_t type = ram[0x0148];
+__extension__ void PrintRomSize(const uint8_t* rom) {
+  uint8_t type = rom[0x0148];
   uint32_t bytes;
   uint32_t banks;
   switch (type) {
@@ -66,8 +66,8 @@ __extension__ void PrintRomSize(uint8_t* ram) {
   printf("[INFO] ROM SIZE: %d KB %d banks\n", bytes, banks);
 }
 
-void PrintRamSize(uint8_t* ram) {
-  uint8_t type = ram[0x0149];
+void PrintRamSize(const uint8_t* rom) {
+  uint8_t type = rom[0x0149];
   static const uint8_t bank_sizes[5] = {0, 1, 1, 4, 16};
   if (type) {
     uint32_t bytes = 512 << (type << 1);
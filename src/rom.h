@@ -3,6 +3,6 @@
 #include <stdint.h>
 #include <stdio.h>
 
-void PrintRomType(uint8_t* ram);
-void PrintRomSize(uint8_t* ram);
-void PrintRamSize(uint8_t* ram);
+void PrintRomType(const uint8_t* rom);
+void PrintRomSize(const uint8_t* rom);
+void PrintRamSize(const uint8_t* rom);
@@ -0,0 +1,74 @@
+#include "sched.h"
+
+static void SchedSwap(struct sched* sched, uint8_t i, uint8_t j) {
+  uint8_t event = sched->heap[i];
+  sched->heap[i] = sched->heap[j];
+  sched->heap[j] = event;
+  sched->pos[sched->heap[i]] = i;
+  sched->pos[sched->heap[j]] = j;
+}
+
+static void SchedUp(struct sched* sched, uint8_t i) {
+  while (i) {
+    uint8_t parent = (i - 1) >> 1;
+    if (sched->at[sched->heap[parent]] <= sched->at[sched->heap[i]]) break;
+    SchedSwap(sched, i, parent);
+    i = parent;
+  }
+}
+
+static void SchedDown(struct sched* sched, uint8_t i) {
+  for (;;) {
+    uint8_t min = i;
+    uint8_t left = (i << 1) + 1, right = left + 1;
+    if (left < sched->size &&
+        sched->at[sched->heap[left]] < sched->at[sched->heap[min]])
+      min = left;
+    if (right < sched->size &&
+        sched->at[sched->heap[right]] < sched->at[sched->heap[min]])
+      min = right;
+    if (min == i) break;
+    SchedSwap(sched, i, min);
+    i = min;
+  }
+}
+
+void SchedInit(struct sched* sched) {
+  sched->now = 0;
+  sched->size = 0;
+  for (uint8_t i = 0; i < EVENT_COUNT; i++) {
+    sched->at[i] = SCHED_NEVER;
+    sched->pos[i] = EVENT_COUNT;
+  }
+}
+
+// schedules event at an absolute time, moves it if already pending
+void SchedAdd(struct sched* sched, uint8_t event, uint64_t at) {
+  if (!SchedPending(sched, event)) {
+    sched->pos[event] = sched->size;
+    sched->heap[sched->size++] = event;
+  }
+  sched->at[event] = at;
+  SchedUp(sched, sched->pos[event]);
+  SchedDown(sched, sched->pos[event]);
+}
+
+void SchedCancel(struct sched* sched, uint8_t event) {
+  if (!SchedPending(sched, event)) return;
+
+  uint8_t i = sched->pos[event];
+  SchedSwap(sched, i, --sched->size);
+  sched->pos[event] = EVENT_COUNT;
+  if (i < sched->size) {
+    SchedUp(sched, i);
+    SchedDown(sched, i);
+  }
+}
+
+// removes and returns the earliest event, its due time stays in at[] so the
+// handler can reschedule relative to it instead of to the late `now`
+uint8_t SchedPop(struct sched* sched) {
+  uint8_t event = sched->heap[0];
+  SchedCancel(sched, event);
+  return event;
+}
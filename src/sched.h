@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SCHED_NEVER UINT64_MAX
+
+// every clocked unit owns one event slot
+enum events {
+  EVENT_PPU,     // next STAT mode change
+  EVENT_SERIAL,  // transfer complete
+  EVENT_DMA,     // OAM DMA complete
+  EVENT_TIMER,   // TIMA overflow
+  EVENT_COUNT,
+};
+
+// Min-heap of pending events keyed on absolute cycle timestamps. The cpu
+// runs until the earliest one, so nothing is polled per instruction.
+struct sched {
+  uint64_t now;               // cycles since power on
+  uint64_t at[EVENT_COUNT];   // due time, kept after the event fired
+  uint8_t heap[EVENT_COUNT];  // pending events, earliest first
+  uint8_t pos[EVENT_COUNT];   // heap index of each pending event
+  uint8_t size;
+};
+
+void SchedInit(struct sched* sched);
+void SchedAdd(struct sched* sched, uint8_t event, uint64_t at);
+void SchedCancel(struct sched* sched, uint8_t event);
+uint8_t SchedPop(struct sched* sched);
+
+static inline uint64_t SchedNext(const struct sched* sched) {
+  return sched->size ? sched->at[sched->heap[0]] : SCHED_NEVER;
+}
+
+static inline bool SchedPending(const struct sched* sched, uint8_t event) {
+  return sched->pos[event] < sched->size &&
+         sched->heap[sched->pos[event]] == event;
+}
@@ -0,0 +1,88 @@
+#include "shade.h"
+
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define SHADE_X86
+#endif
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define SHADE_LE
+#endif
+
+// a lookup per pixel, the reference for the others
+static void ShadeConvertScalar(uint32_t* out, const uint8_t* in, size_t count,
+                               const uint32_t palette[4]) {
+  for (size_t i = 0; i < count; i++) out[i] = palette[in[i] & 0x03];
+}
+
+#ifdef SHADE_LE
+// two pixels per lookup in a table of every pair of shades
+static void ShadeConvertPair(uint32_t* out, const uint8_t* in, size_t count,
+                             const uint32_t palette[4]) {
+  uint64_t pairs[16];
+  size_t i = 0;
+
+  for (int p = 0; p < 16; p++)
+    pairs[p] = palette[p & 0x03] | (uint64_t)palette[p >> 2] << 040;
+  for (; i + 2 <= count; i += 2)
+    memcpy(out + i, &pairs[(in[i] & 0x03) | (in[i + 1] & 0x03) << 2], 8);
+  if (i < count) out[i] = palette[in[i] & 0x03];
+}
+#endif
+
+#ifdef SHADE_X86
+// the palette is one vector, PSHUFB looks up 4 pixels at a time: each shade
+// times 4 is spread over its pixel's 4 bytes and offset to its ARGB bytes
+__attribute__((target("ssse3"))) static void ShadeConvertSsse3(
+    uint32_t* out, const uint8_t* in, size_t count,
+    const uint32_t palette[4]) {
+  const __m128i lut = _mm_loadu_si128((const __m128i*)palette);
+  const __m128i bytes = _mm_set1_epi32(0x03020100);
+  const __m128i mask = _mm_set1_epi8(0x03);
+  const __m128i spread[4] = {
+      _mm_set_epi8(3, 3, 3, 3, 2, 2, 2, 2, 1, 1, 1, 1, 0, 0, 0, 0),
+      _mm_set_epi8(7, 7, 7, 7, 6, 6, 6, 6, 5, 5, 5, 5, 4, 4, 4, 4),
+      _mm_set_epi8(11, 11, 11, 11, 10, 10, 10, 10, 9, 9, 9, 9, 8, 8, 8, 8),
+      _mm_set_epi8(15, 15, 15, 15, 14, 14, 14, 14, 13, 13, 13, 13, 12, 12,
+                   12, 12)};
+  size_t i = 0;
+
+  for (; i + 16 <= count; i += 16) {
+    __m128i shades = _mm_loadu_si128((const __m128i*)(in + i));
+    shades = _mm_and_si128(shades, mask);
+    shades = _mm_add_epi8(shades, shades);
+    shades = _mm_add_epi8(shades, shades);
+    for (int j = 0; j < 4; j++) {
+      __m128i index =
+          _mm_add_epi8(_mm_shuffle_epi8(shades, spread[j]), bytes);
+      _mm_storeu_si128((__m128i*)(out + i + j * 4),
+                       _mm_shuffle_epi8(lut, index));
+    }
+  }
+  ShadeConvertScalar(out + i, in + i, count - i, palette);
+}
+#endif
+
+ShadeConverter ShadeConverterGet(const char* name) {
+  if (!strcmp(name, "scalar")) return ShadeConvertScalar;
+#ifdef SHADE_LE
+  if (!strcmp(name, "pair")) return ShadeConvertPair;
+#endif
+#ifdef SHADE_X86
+  if (!strcmp(name, "ssse3"))
+    return __builtin_cpu_supports("ssse3") ? ShadeConvertSsse3 : NULL;
+#endif
+  return NULL;
+}
+
+ShadeConverter ShadeConverterBest(void) {
+  static const char* Order[] = {"ssse3", "pair"};
+
+  for (size_t i = 0; i < sizeof(Order) / sizeof(Order[0]); i++) {
+    ShadeConverter convert = ShadeConverterGet(Order[i]);
+    if (convert) return convert;
+  }
+  return ShadeConvertScalar;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Shade converters, the PPU's 2 bit shades (BGP already applied) to ARGB
+// through a 4 entry palette, count pixels from in to out.
+typedef void (*ShadeConverter)(uint32_t* out, const uint8_t* in, size_t count,
+                               const uint32_t palette[4]);
+
+// NULL when this cpu or build can't run the named one: "scalar", "pair" or
+// "ssse3"
+ShadeConverter ShadeConverterGet(const char* name);
+
+// the fastest one this cpu runs
+ShadeConverter ShadeConverterBest(void);
@@ -0,0 +1,236 @@
+#include "snap.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gb.h"
+#include "io.h"
+
+#define SNAP_ALIGN(size) (((size) + 7) & ~(size_t)7)
+#define SNAP_PARTS 8
+
+// one chunk, where it lives in this machine
+struct snap_part {
+  char tag[4];
+  uint8_t* data;
+  size_t size;
+};
+
+// the chunks of a machine in the order they are saved. The cartridge ram
+// and the frame being drawn are outside struct gb, the rest is in place.
+static int SnapParts(const struct gb* gb, struct snap_part parts[]) {
+  struct gb* g = (struct gb*)gb;
+  int count = 0;
+
+#define SNAP_PART(t, d, s)                                             \
+  parts[count++] =                                                     \
+      (struct snap_part){.tag = t, .data = (uint8_t*)(d), .size = (s)}
+  SNAP_PART("CPU ", &g->cpu, sizeof(g->cpu));
+  SNAP_PART("SCHD", &g->sched, sizeof(g->sched));
+  SNAP_PART("TIMR", &g->timer, sizeof(g->timer));
+  SNAP_PART("MBC ", &g->mbc, sizeof(g->mbc));
+  SNAP_PART("PPU ", &g->ppu, offsetof(struct ppu, frameSkip));
+  SNAP_PART("RAM ", g->ram + VRAM, sizeof(g->ram) - VRAM);
+  SNAP_PART("BOOT", g->boot, sizeof(g->boot));
+  SNAP_PART("FRAM", g->ppu.frame, sizeof(g->ppu.screen));
+  if (g->mbc.ramSize) SNAP_PART("CRAM", g->mbc.ram, g->mbc.ramSize);
+#undef SNAP_PART
+  return count;
+}
+
+static uint16_t SnapChecksum(const struct gb* gb) {
+  const struct cart* cart = gb->cart;
+  return cart->size > 0x14F ? cart->data[0x14E] << 010 | cart->data[0x14F]
+                            : 0;
+}
+
+size_t SnapSize(const struct gb* gb) {
+  struct snap_part parts[SNAP_PARTS + 1];
+  int count = SnapParts(gb, parts);
+  size_t size = sizeof(struct snap_header);
+
+  for (int i = 0; i < count; i++)
+    size += sizeof(struct snap_chunk) + SNAP_ALIGN(parts[i].size);
+  return size;
+}
+
+// out holds SnapSize bytes, 8 byte aligned. Returns the bytes written.
+size_t SnapSave(const struct gb* gb, uint8_t* out) {
+  struct snap_part parts[SNAP_PARTS + 1];
+  int count = SnapParts(gb, parts);
+  struct snap_header* header = (struct snap_header*)out;
+  uint8_t* p = out + sizeof(*header);
+
+  for (int i = 0; i < count; i++) {
+    struct snap_chunk* chunk = (struct snap_chunk*)p;
+    memcpy(chunk->tag, parts[i].tag, 4);
+    chunk->size = parts[i].size;
+    p += sizeof(*chunk);
+    memcpy(p, parts[i].data, parts[i].size);
+    memset(p + parts[i].size, 0, SNAP_ALIGN(parts[i].size) - parts[i].size);
+    if (!memcmp(chunk->tag, "CPU ", 4)) ((struct cpu*)p)->bus = NULL;
+    if (!memcmp(chunk->tag, "MBC ", 4)) ((struct mbc*)p)->ram = NULL;
+    p += SNAP_ALIGN(parts[i].size);
+  }
+
+  *header = (struct snap_header){.magic = SNAP_MAGIC,
+                                  .version = SNAP_VERSION,
+                                  .size = p - out,
+                                  .checksum = SnapChecksum(gb),
+                                  .chunks = count};
+  return p - out;
+}
+
+// the chunk tagged tag, NULL when the state has none
+static const struct snap_chunk* SnapFind(const uint8_t* in, size_t size,
+                                           const char tag[4]) {
+  const struct snap_header* header = (const struct snap_header*)in;
+  const uint8_t* p = in + sizeof(*header);
+  const uint8_t* end = in + size;
+
+  for (uint16_t i = 0; i < header->chunks; i++) {
+    const struct snap_chunk* chunk = (const struct snap_chunk*)p;
+    if (end - p < (ptrdiff_t)sizeof(*chunk) ||
+        (size_t)(end - p) - sizeof(*chunk) < chunk->size)
+      return NULL;
+    if (!memcmp(chunk->tag, tag, 4)) return chunk;
+    p += sizeof(*chunk) + SNAP_ALIGN(chunk->size);
+  }
+  return NULL;
+}
+
+// Checks every chunk before anything is copied, a state that doesn't fit
+// leaves the machine as it was. The cartridge is the one the machine runs,
+// so it has the same ram size as the saved mbc.
+// The scheduler heap and the PPU's mode and sprite count are used as indices
+// without checks, an edited or damaged state mustn't send them past their
+// arrays.
+static bool SnapIndicesValid(const struct sched* sched,
+                             const struct ppu* ppu) {
+  if (sched->size > EVENT_COUNT) return false;
+  for (uint8_t event = 0; event < EVENT_COUNT; event++)
+    if (sched->pos[event] > EVENT_COUNT) return false;
+  for (uint8_t i = 0; i < sched->size; i++) {
+    uint8_t event = sched->heap[i];
+    if (event >= EVENT_COUNT || sched->pos[event] != i) return false;
+    if (i && sched->at[sched->heap[(i - 1) >> 1]] > sched->at[event])
+      return false;
+  }
+  return ppu->mode <= MODE_TRANSFER && ppu->spriteCount <= SPRITES_PER_LINE;
+}
+
+// the banks a mapper can select, anything else would map past the cartridge
+static bool SnapBanksValid(const struct mbc* mbc) {
+  switch (mbc->type) {
+    case MBC_1:
+      return mbc->romBank <= 0x1F && mbc->ramBank <= 0x03 && mbc->mode <= 1;
+    case MBC_3:
+      return mbc->romBank <= 0x7F;
+    case MBC_5:
+      return mbc->romBank <= 0x1FF && mbc->ramBank <= 0x0F;
+  }
+  return mbc->romBank == 1 && !mbc->ramBank;
+}
+
+int SnapLoad(struct gb* gb, const uint8_t* in, size_t size) {
+  const struct snap_header* header = (const struct snap_header*)in;
+  struct snap_part parts[SNAP_PARTS + 1];
+  const struct snap_chunk* chunks[SNAP_PARTS + 1];
+  int count = SnapParts(gb, parts);
+
+  if (size < sizeof(*header) || memcmp(header->magic, SNAP_MAGIC, 4) ||
+      header->version != SNAP_VERSION || header->size > size) {
+    printf("[ERROR] %s: not a save state of this version\n", __func__);
+    return SNAP_ERROR_FORMAT;
+  }
+  if (header->checksum != SnapChecksum(gb)) {
+    printf("[ERROR] %s: the state is for another cartridge\n", __func__);
+    return SNAP_ERROR_CART;
+  }
+  for (int i = 0; i < count; i++) {
+    chunks[i] = SnapFind(in, header->size, parts[i].tag);
+    if (!chunks[i] || chunks[i]->size != parts[i].size) {
+      printf("[ERROR] %s: chunk %.4s is missing or of another size\n",
+             __func__, parts[i].tag);
+      return SNAP_ERROR_FORMAT;
+    }
+  }
+  const struct mbc* mbc =
+      (const struct mbc*)(SnapFind(in, header->size, "MBC ") + 1);
+  if (mbc->type != gb->mbc.type || mbc->romBanks != gb->mbc.romBanks ||
+      mbc->ramSize != gb->mbc.ramSize || mbc->clock != gb->mbc.clock) {
+    printf("[ERROR] %s: the state is for another cartridge\n", __func__);
+    return SNAP_ERROR_CART;
+  }
+  if (!SnapBanksValid(mbc) ||
+      !SnapIndicesValid(
+          (const struct sched*)(SnapFind(in, header->size, "SCHD") + 1),
+          (const struct ppu*)(SnapFind(in, header->size, "PPU ") + 1))) {
+    printf("[ERROR] %s: the state is damaged\n", __func__);
+    return SNAP_ERROR_FORMAT;
+  }
+
+  struct bus* bus = gb->cpu.bus;
+  uint8_t* ram = gb->mbc.ram;
+  for (int i = 0; i < count; i++)
+    memcpy(parts[i].data, chunks[i] + 1, parts[i].size);
+  gb->cpu.bus = bus;
+  gb->mbc.ram = ram;
+
+  MbcRemap(gb);
+  memset(gb->ppu.dirty, 0xFF, sizeof(gb->ppu.dirty));
+  gb->idle.miss = false;
+  return SNAP_OK;
+}
+
+int SnapWrite(const struct gb* gb, const char* fileName) {
+  size_t size = SnapSize(gb);
+  uint8_t* state = malloc(size);
+  int status = SNAP_OK;
+
+  if (!state) {
+    printf("[ERROR] %s: no memory for the state\n", __func__);
+    return SNAP_ERROR_MEMORY;
+  }
+  SnapSave(gb, state);
+
+  FILE* f = fopen(fileName, "wb");
+  if (!f) {
+    printf("[ERROR] %s: can't open %s\n", __func__, fileName);
+    status = SNAP_ERROR_FILE;
+  } else if (fwrite(state, 1, size, f) != size) {
+    printf("[ERROR] %s: can't write %s\n", __func__, fileName);
+    status = SNAP_ERROR_FILE;
+  }
+  if (f && fclose(f) && status == SNAP_OK) {
+    printf("[ERROR] %s: can't write %s\n", __func__, fileName);
+    status = SNAP_ERROR_FILE;
+  }
+  free(state);
+
+  if (status == SNAP_OK) printf("[INFO] State saved at %s\n", fileName);
+  return status;
+}
+
+int SnapRead(struct gb* gb, const char* fileName) {
+  FILE* f = fopen(fileName, "rb");
+  if (!f) {
+    printf("[ERROR] %s: file %s not found!\n", __func__, fileName);
+    return SNAP_ERROR_FILE;
+  }
+
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  uint8_t* state = size > 0 ? malloc(size) : NULL;
+  int status = SNAP_ERROR_FILE;
+
+  if (!state || fread(state, 1, size, f) != (size_t)size)
+    printf("[ERROR] %s: can't read %s\n", __func__, fileName);
+  else
+    status = SnapLoad(gb, state, size);
+  fclose(f);
+  free(state);
+  return status;
+}
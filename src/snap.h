@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SNAP_OK 0
+#define SNAP_ERROR_FILE 1
+#define SNAP_ERROR_FORMAT 2
+#define SNAP_ERROR_CART 3
+#define SNAP_ERROR_MEMORY 4
+
+// Save state: a header, then chunks of a tag, a size and that many bytes,
+// each starting 8 byte aligned. Chunks are the machine's structs and memory
+// exactly as they are in struct gb, so saving and loading are one memcpy a
+// chunk. Pointers in them are cleared on save and set again on load, what
+// only caches what's elsewhere (decoded tiles, bus pages) is rebuilt. A
+// loader skips tags it doesn't know, the version goes up whenever a saved
+// struct changes. Only between GbRun calls.
+#define SNAP_MAGIC "GBSS"
+#define SNAP_VERSION 1
+
+struct snap_header {
+  char magic[4];
+  uint32_t version;
+  uint32_t size;      // the whole state, header included
+  uint16_t checksum;  // the cart's global checksum, the state is only for it
+  uint16_t chunks;
+};
+
+struct snap_chunk {
+  char tag[4];
+  uint32_t size;  // bytes following, padding not counted
+};
+
+struct gb;
+
+// bytes SnapSave writes for this machine, the same until the next GbInit
+size_t SnapSize(const struct gb* gb);
+size_t SnapSave(const struct gb* gb, uint8_t* out);
+int SnapLoad(struct gb* gb, const uint8_t* in, size_t size);
+int SnapWrite(const struct gb* gb, const char* fileName);
+int SnapRead(struct gb* gb, const char* fileName);
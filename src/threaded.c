@@ -0,0 +1,187 @@
+#include "cpu.h"
+
+// The engine runs on a copy of gb->cpu whose address is never taken, so no
+// store through a bus page can alias it and the registers aren't reloaded
+// after every write. Only the bus handlers see the machine, gb->cpu is
+// brought up to date before they run and read back after a write.
+//
+// Split into scalars (SRA) the copy is more values than there are host
+// registers, and as every opcode meets the others at the dispatch they end
+// up in stack slots shuffled at every jump. Kept whole it is a struct at
+// fixed stack offsets, which is faster.
+#if CPU_ENGINE == CPU_ENGINE_THREADED && !defined(__clang__)
+#pragma GCC optimize("no-tree-sra")
+#endif
+
+#include "gb.h"
+
+#define OPS_OWN_BUS
+
+static inline uint8_t Read8(struct cpu* cpu, uint16_t addr) {
+  const struct bus* bus = cpu->bus;
+  const uint8_t* page = bus->read[addr >> 010];
+
+  if (__builtin_expect(page != NULL, 1)) return page[addr & 0xFF];
+  bus->gb->cpu = *cpu;
+  return bus->reader[addr >> 010](bus->gb, addr);
+}
+
+static inline void Write8(struct cpu* cpu, uint16_t addr, uint8_t u8) {
+  const struct bus* bus = cpu->bus;
+  uint8_t* page = bus->write[addr >> 010];
+
+  if (__builtin_expect(page != NULL, 1)) {
+    page[addr & 0xFF] = u8;
+    return;
+  }
+  bus->gb->cpu = *cpu;
+  bus->writer[addr >> 010](bus->gb, &bus->gb->cpu, addr, u8);
+  *cpu = bus->gb->cpu;
+}
+
+#include "ops.h"
+#include "trace.h"
+
+#if CPU_ENGINE == CPU_ENGINE_THREADED
+
+// labels as values and `goto *` are GNU C
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+// every opcode gets its own copy of its handler, the operand fields are
+// constants there so the register picks fold away
+#define SAME(X, hi, op)                                            \
+  X(hi##0, op) X(hi##1, op) X(hi##2, op) X(hi##3, op) X(hi##4, op) \
+  X(hi##5, op) X(hi##6, op) X(hi##7, op) X(hi##8, op) X(hi##9, op) \
+  X(hi##A, op) X(hi##B, op) X(hi##C, op) X(hi##D, op) X(hi##E, op) \
+  X(hi##F, op)
+
+// primary opcodes, P takes the 0xCB prefix
+#define OPS(X, P)                                                  \
+  X(00, OpNop) X(01, OpLdRpU16) X(02, OpLdIndA) X(03, OpIncRp)     \
+  X(04, OpIncR8) X(05, OpDecR8) X(06, OpLdR8U8) X(07, OpRotA)      \
+  X(08, OpLdU16Sp) X(09, OpAddHlRp) X(0A, OpLdAInd) X(0B, OpDecRp) \
+  X(0C, OpIncR8) X(0D, OpDecR8) X(0E, OpLdR8U8) X(0F, OpRotA)      \
+  X(10, OpStop) X(11, OpLdRpU16) X(12, OpLdIndA) X(13, OpIncRp)    \
+  X(14, OpIncR8) X(15, OpDecR8) X(16, OpLdR8U8) X(17, OpRotA)      \
+  X(18, OpJr) X(19, OpAddHlRp) X(1A, OpLdAInd) X(1B, OpDecRp)      \
+  X(1C, OpIncR8) X(1D, OpDecR8) X(1E, OpLdR8U8) X(1F, OpRotA)      \
+  X(20, OpJrCc) X(21, OpLdRpU16) X(22, OpLdIndA) X(23, OpIncRp)    \
+  X(24, OpIncR8) X(25, OpDecR8) X(26, OpLdR8U8) X(27, OpDaa)       \
+  X(28, OpJrCc) X(29, OpAddHlRp) X(2A, OpLdAInd) X(2B, OpDecRp)    \
+  X(2C, OpIncR8) X(2D, OpDecR8) X(2E, OpLdR8U8) X(2F, OpCpl)       \
+  X(30, OpJrCc) X(31, OpLdRpU16) X(32, OpLdIndA) X(33, OpIncRp)    \
+  X(34, OpIncR8) X(35, OpDecR8) X(36, OpLdR8U8) X(37, OpScf)       \
+  X(38, OpJrCc) X(39, OpAddHlRp) X(3A, OpLdAInd) X(3B, OpDecRp)    \
+  X(3C, OpIncR8) X(3D, OpDecR8) X(3E, OpLdR8U8) X(3F, OpCcf)       \
+  SAME(X, 4, OpLdR8R8) SAME(X, 5, OpLdR8R8) SAME(X, 6, OpLdR8R8)   \
+  X(70, OpLdR8R8) X(71, OpLdR8R8) X(72, OpLdR8R8) X(73, OpLdR8R8)  \
+  X(74, OpLdR8R8) X(75, OpLdR8R8) X(76, OpHalt) X(77, OpLdR8R8)    \
+  X(78, OpLdR8R8) X(79, OpLdR8R8) X(7A, OpLdR8R8) X(7B, OpLdR8R8)  \
+  X(7C, OpLdR8R8) X(7D, OpLdR8R8) X(7E, OpLdR8R8) X(7F, OpLdR8R8)  \
+  SAME(X, 8, OpAluR8) SAME(X, 9, OpAluR8) SAME(X, A, OpAluR8)      \
+  SAME(X, B, OpAluR8)                                              \
+  X(C0, OpRetCc) X(C1, OpPop) X(C2, OpJpCc) X(C3, OpJp)            \
+  X(C4, OpCallCc) X(C5, OpPush) X(C6, OpAluU8) X(C7, OpRst)        \
+  X(C8, OpRetCc) X(C9, OpRet) X(CA, OpJpCc) P(CB)                  \
+  X(CC, OpCallCc) X(CD, OpCall) X(CE, OpAluU8) X(CF, OpRst)        \
+  X(D0, OpRetCc) X(D1, OpPop) X(D2, OpJpCc) X(D3, OpIllegal)       \
+  X(D4, OpCallCc) X(D5, OpPush) X(D6, OpAluU8) X(D7, OpRst)        \
+  X(D8, OpRetCc) X(D9, OpRetI) X(DA, OpJpCc) X(DB, OpIllegal)      \
+  X(DC, OpCallCc) X(DD, OpIllegal) X(DE, OpAluU8) X(DF, OpRst)     \
+  X(E0, OpLdhU8A) X(E1, OpPop) X(E2, OpLdhCA) X(E3, OpIllegal)     \
+  X(E4, OpIllegal) X(E5, OpPush) X(E6, OpAluU8) X(E7, OpRst)       \
+  X(E8, OpAddSpI8) X(E9, OpJpHl) X(EA, OpLdU16A) X(EB, OpIllegal)  \
+  X(EC, OpIllegal) X(ED, OpIllegal) X(EE, OpAluU8) X(EF, OpRst)    \
+  X(F0, OpLdhAU8) X(F1, OpPop) X(F2, OpLdhAC) X(F3, OpDi)          \
+  X(F4, OpIllegal) X(F5, OpPush) X(F6, OpAluU8) X(F7, OpRst)       \
+  X(F8, OpLdHlSpI8) X(F9, OpLdSpHl) X(FA, OpLdAU16) X(FB, OpEi)    \
+  X(FC, OpIllegal) X(FD, OpIllegal) X(FE, OpAluU8) X(FF, OpRst)
+
+// 0xCB prefixed opcodes
+#define CB_OPS(X)                                             \
+  SAME(X, 0, OpCbRot) SAME(X, 1, OpCbRot) SAME(X, 2, OpCbRot) \
+  SAME(X, 3, OpCbRot) SAME(X, 4, OpCbBit) SAME(X, 5, OpCbBit) \
+  SAME(X, 6, OpCbBit) SAME(X, 7, OpCbBit) SAME(X, 8, OpCbRes) \
+  SAME(X, 9, OpCbRes) SAME(X, A, OpCbRes) SAME(X, B, OpCbRes) \
+  SAME(X, C, OpCbSet) SAME(X, D, OpCbSet) SAME(X, E, OpCbSet) \
+  SAME(X, F, OpCbSet)
+
+#define OP_LABEL(n, op) [0x##n] = &&op_##n,
+#define CB_LABEL(n, op) [0x##n] = &&cb_##n,
+#define PREFIX_LABEL(n) [0x##n] = &&prefix,
+#define NO_PREFIX(n)
+
+// the trace hooks take gb->cpu, so c keeps out of memory when they're off
+#if CPU_TRACE == CPU_TRACE_OFF
+#define STEP() TRACE_STEP(gb, &c, pc, taken)
+#else
+#define STEP() (gb->cpu = c, TRACE_STEP(gb, &gb->cpu, pc, taken))
+#endif
+
+// every opcode ends in its own indirect jump to the next one, which gives
+// the branch predictor one history slot per opcode
+#define DISPATCH()                                   \
+  do {                                               \
+    if (ran >= budget || c.hlt || c.yield) goto out; \
+    c.ran = ran;                                     \
+    pc = c.pc;                                       \
+    opcode = Fetch8(&c);                             \
+    goto *ops[opcode];                               \
+  } while (0)
+
+#define OP(n, op)                 \
+  op_##n : taken = op(&c, 0x##n); \
+  if (!taken) goto illegal;       \
+  ran += taken;                   \
+  STEP();                         \
+  DISPATCH();
+
+#define CB(n, op)                 \
+  cb_##n : taken = op(&c, 0x##n); \
+  ran += taken;                   \
+  STEP();                         \
+  DISPATCH();
+
+// flatten inlines the handlers however large this function gets
+__attribute__((flatten)) int CpuRun(struct gb* gb, uint32_t budget,
+                                    uint32_t* cycles) {
+  static const void* const ops[0x100] = {OPS(OP_LABEL, PREFIX_LABEL)};
+  static const void* const cbops[0x100] = {CB_OPS(CB_LABEL)};
+
+  struct cpu c = gb->cpu;
+  uint32_t ran = 0;
+  uint16_t pc;
+  uint8_t opcode, taken;
+  int state = CPU_OK;
+
+  c.yield = false;
+  DISPATCH();
+
+  OPS(OP, NO_PREFIX)
+
+prefix:
+  opcode = Fetch8(&c);
+  goto *cbops[opcode];
+
+  CB_OPS(CB)
+
+illegal:
+  state = CPU_ERROR_UNK_INSTRUCTION;
+
+out:
+  gb->cpu = c;
+  *cycles = ran;
+  return state;
+}
+
+#pragma GCC diagnostic pop
+
+int CpuStep(struct gb* gb, uint8_t* cycles) {
+  uint32_t ran;
+  int state = CpuRun(gb, 1, &ran);
+  *cycles = ran;
+  return state;
+}
+
+#endif
@@ -0,0 +1,118 @@
+#include "tile.h"
+
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define TILE_X86
+#endif
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define TILE_LE
+#endif
+
+// bit by bit, the reference for the others
+static void TileDecodeScalar(const uint8_t* data, uint8_t out[8][8]) {
+  for (int y = 0; y < 8; y++) {
+    uint8_t lsb = data[y * 2], msb = data[y * 2 + 1];
+    for (int x = 0; x < 8; x++)
+      out[y][x] = (lsb >> (7 - x) & 1) | (msb >> (7 - x) & 1) << 1;
+  }
+}
+
+#ifdef TILE_LE
+// each bit of a byte moved to the low bit of its own byte, leftmost first
+#define SPREAD(b)                                                     \
+  ((uint64_t)((b) >> 7 & 1) | (uint64_t)((b) >> 6 & 1) << 010 |      \
+   (uint64_t)((b) >> 5 & 1) << 020 | (uint64_t)((b) >> 4 & 1) << 030 | \
+   (uint64_t)((b) >> 3 & 1) << 040 | (uint64_t)((b) >> 2 & 1) << 050 | \
+   (uint64_t)((b) >> 1 & 1) << 060 | (uint64_t)((b) & 1) << 070)
+#define SPREAD4(b) SPREAD(b), SPREAD(b + 1), SPREAD(b + 2), SPREAD(b + 3)
+#define SPREAD16(b) \
+  SPREAD4(b), SPREAD4(b + 4), SPREAD4(b + 8), SPREAD4(b + 12)
+#define SPREAD64(b) \
+  SPREAD16(b), SPREAD16(b + 16), SPREAD16(b + 32), SPREAD16(b + 48)
+
+static const uint64_t TileSpread[0x100] = {SPREAD64(0), SPREAD64(64),
+                                           SPREAD64(128), SPREAD64(192)};
+
+// a row is two lookups in a 2 KiB table
+static void TileDecodeTable(const uint8_t* data, uint8_t out[8][8]) {
+  for (int y = 0; y < 8; y++) {
+    uint64_t row = TileSpread[data[y * 2]] | TileSpread[data[y * 2 + 1]] << 1;
+    memcpy(out[y], &row, 8);
+  }
+}
+#endif
+
+#ifdef TILE_X86
+// two rows per vector: each byte broadcast over 8 lanes, tested against its
+// lane's bit, then the lsb and msb halves added up
+static void TileDecodeSse2(const uint8_t* data, uint8_t out[8][8]) {
+  const __m128i bits = _mm_set_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8,
+                                    16, 32, 64, -128);
+  const __m128i weights = _mm_set_epi8(2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1,
+                                       1, 1, 1);
+  __m128i tile = _mm_loadu_si128((const __m128i*)data);
+  __m128i pairs[2] = {_mm_unpacklo_epi8(tile, tile),
+                      _mm_unpackhi_epi8(tile, tile)};
+
+  for (int half = 0; half < 2; half++) {
+    __m128i quads[2] = {_mm_unpacklo_epi16(pairs[half], pairs[half]),
+                        _mm_unpackhi_epi16(pairs[half], pairs[half])};
+    for (int i = 0; i < 2; i++) {
+      __m128i rows[2] = {_mm_unpacklo_epi32(quads[i], quads[i]),
+                         _mm_unpackhi_epi32(quads[i], quads[i])};
+      for (int j = 0; j < 2; j++) {
+        // lanes 0-7 the lsb, 8-15 the msb of one row
+        __m128i set = _mm_cmpeq_epi8(_mm_and_si128(rows[j], bits), bits);
+        __m128i px = _mm_and_si128(set, weights);
+        px = _mm_add_epi8(px, _mm_srli_si128(px, 8));
+        _mm_storel_epi64((__m128i*)out[half * 4 + i * 2 + j], px);
+      }
+    }
+  }
+}
+
+// PDEP spreads the bits, the byte swap puts bit 7 leftmost
+__attribute__((target("bmi2"))) static void TileDecodeBmi2(
+    const uint8_t* data, uint8_t out[8][8]) {
+  for (int y = 0; y < 8; y++) {
+    uint64_t row = _pdep_u64(data[y * 2], 0x0101010101010101) |
+                   _pdep_u64(data[y * 2 + 1], 0x0202020202020202);
+    row = __builtin_bswap64(row);
+    memcpy(out[y], &row, 8);
+  }
+}
+#endif
+
+TileDecoder TileDecoderGet(const char* name) {
+  if (!strcmp(name, "scalar")) return TileDecodeScalar;
+#ifdef TILE_LE
+  if (!strcmp(name, "table")) return TileDecodeTable;
+#endif
+#ifdef TILE_X86
+  if (!strcmp(name, "sse2")) return TileDecodeSse2;
+  if (!strcmp(name, "bmi2"))
+    return __builtin_cpu_supports("bmi2") ? TileDecodeBmi2 : NULL;
+#endif
+  return NULL;
+}
+
+// By tilebench's times: bmi2 and table are about even, sse2 a fifth
+// slower. Zen 1 and 2 microcode PDEP, hundreds of cycles each, so bmi2 isn't
+// tried there and they start at table.
+TileDecoder TileDecoderBest(void) {
+  static const char* Order[] = {"bmi2", "table", "sse2"};
+
+  for (size_t i = 0; i < sizeof(Order) / sizeof(Order[0]); i++) {
+#ifdef TILE_X86
+    if (!strcmp(Order[i], "bmi2") &&
+        (__builtin_cpu_is("znver1") || __builtin_cpu_is("znver2")))
+      continue;
+#endif
+    TileDecoder decode = TileDecoderGet(Order[i]);
+    if (decode) return decode;
+  }
+  return TileDecodeScalar;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdint.h>
+
+// Tile decoders, 16 bytes of 2bpp tile data to a color index per pixel. Each
+// row is a (lsb, msb) byte pair, bit 7 is the leftmost pixel.
+typedef void (*TileDecoder)(const uint8_t* data, uint8_t out[8][8]);
+
+// NULL when this cpu or build can't run the named one: "scalar", "table",
+// "sse2" or "bmi2"
+TileDecoder TileDecoderGet(const char* name);
+
+// the fastest one this cpu runs
+TileDecoder TileDecoderBest(void);
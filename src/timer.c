@@ -0,0 +1,112 @@
+#include "timer.h"
+
+#include "gb.h"
+
+// TIMA period in cycles by TAC input clock, twice the selected divider bit
+static const uint16_t TimerPeriod[4] = {1024, 16, 64, 256};
+
+#define TIMER_ON(tac) CHECK_BIT(2, tac)
+
+// edges of the selected bit from the divider reset to at
+static uint64_t TimerEdges(const struct timer* timer, uint64_t at) {
+  return (at - timer->divAt) / TimerPeriod[timer->tac & 0x03];
+}
+
+// brings ram[TIMA] up to now, before anything changes how it counts. An
+// overflow the event didn't get to yet is done here, TimerSchedule moves the
+// event on.
+static void TimerSync(struct gb* gb, uint64_t now) {
+  struct timer* timer = &gb->timer;
+  uint64_t edges = 0;
+
+  if (TIMER_ON(timer->tac))
+    edges = TimerEdges(timer, now) - TimerEdges(timer, timer->timaAt);
+  while (edges >= 0x100u - gb->ram[TIMA]) {
+    edges -= 0x100u - gb->ram[TIMA];
+    gb->ram[TIMA] = gb->ram[TMA];
+    gb->ram[IF] |= INT_TIMER;
+  }
+  gb->ram[TIMA] += edges;
+  timer->timaAt = now;
+}
+
+// the next overflow, 0x100 - TIMA edges after the last one counted
+static void TimerSchedule(struct gb* gb) {
+  struct timer* timer = &gb->timer;
+
+  if (!TIMER_ON(timer->tac)) {
+    SchedCancel(&gb->sched, EVENT_TIMER);
+    return;
+  }
+  uint64_t edge = TimerEdges(timer, timer->timaAt) + 0x100 - gb->ram[TIMA];
+  SchedAdd(&gb->sched, EVENT_TIMER,
+           timer->divAt + edge * TimerPeriod[timer->tac & 0x03]);
+}
+
+// one TIMA increment outside the divider's own edges, see TimerWrite
+static void TimerTick(struct gb* gb) {
+  if (++gb->ram[TIMA]) return;
+  gb->ram[TIMA] = gb->ram[TMA];
+  gb->ram[IF] |= INT_TIMER;
+}
+
+// div is the divider at cycle 0, 0 with the boot rom and 0xABCC after it
+void TimerInit(struct gb* gb, uint16_t div) {
+  gb->timer.divAt = 0 - (uint64_t)div;
+  gb->timer.timaAt = 0;
+  gb->timer.tac = gb->ram[TAC];
+  TimerSchedule(gb);
+}
+
+uint8_t TimerRead(struct gb* gb, uint16_t addr) {
+  struct timer* timer = &gb->timer;
+  uint64_t now = GbNow(gb);
+
+  switch (addr) {
+    case DIV:
+      return (now - timer->divAt) >> 010;
+    case TIMA:
+      if (!TIMER_ON(timer->tac)) return gb->ram[TIMA];
+      return gb->ram[TIMA] + TimerEdges(timer, now) -
+             TimerEdges(timer, timer->timaAt);
+    case TAC:
+      return gb->ram[TAC] | 0xF8;
+  }
+  return gb->ram[addr];
+}
+
+// DIV, TIMA or TAC was written. Resetting the divider or switching the input
+// away from a set bit is a falling edge too, so TIMA can count one more.
+void TimerWrite(struct gb* gb, uint16_t addr) {
+  struct timer* timer = &gb->timer;
+  uint64_t now = GbNow(gb);
+  uint16_t bit = TimerPeriod[timer->tac & 0x03] >> 1;
+  bool high = TIMER_ON(timer->tac) && ((now - timer->divAt) & bit);
+
+  switch (addr) {
+    case DIV:
+      TimerSync(gb, now);
+      timer->divAt = now;
+      if (high) TimerTick(gb);
+      break;
+    case TIMA:
+      timer->timaAt = now;  // the write replaced the count
+      break;
+    case TAC:
+      TimerSync(gb, now);
+      timer->tac = gb->ram[TAC];
+      bit = TimerPeriod[timer->tac & 0x03] >> 1;
+      if (high && !(TIMER_ON(timer->tac) && ((now - timer->divAt) & bit)))
+        TimerTick(gb);
+      break;
+  }
+  TimerSchedule(gb);
+}
+
+// TIMA overflowed, it's reloaded from TMA and requests the interrupt
+void TimerEvent(struct gb* gb) {
+  gb->ram[TIMA] = gb->ram[TMA];
+  gb->ram[IF] |= INT_TIMER;
+  gb->timer.timaAt = gb->sched.at[EVENT_TIMER];
+  TimerSchedule(gb);
+}
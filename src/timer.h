@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+
+// timer regs
+#define DIV 0xFF04   // bits 15-8 of the internal divider
+#define TIMA 0xFF05  // counts falling edges of the divider bit TAC selects
+#define TMA 0xFF06   // TIMA reload on overflow
+#define TAC 0xFF07
+/*-TAC-+------------------+------------------------------+
+ |  2  | Timer enable     |                              |
+ | 1-0 | Input clock      | 00: 4096 Hz, divider bit 9   |
+ |     |                  | 01: 262144 Hz, bit 3         |
+ |     |                  | 10: 65536 Hz, bit 5          |
+ |     |                  | 11: 16384 Hz, bit 7          |
+ +-----+------------------+-----------------------------*/
+
+// Nothing ticks per instruction. The divider is the cycles since divAt and
+// TIMA is ram[TIMA] plus the selected bit's falling edges since timaAt, both
+// worked out when read. Overflow is an EVENT_TIMER at the edge it happens.
+struct timer {
+  uint64_t divAt;   // cycle the divider was 0
+  uint64_t timaAt;  // cycle ram[TIMA] was brought up to
+  uint8_t tac;      // TAC the count since timaAt ran with
+};
+
+struct gb;
+
+void TimerInit(struct gb* gb, uint16_t div);
+uint8_t TimerRead(struct gb* gb, uint16_t addr);
+void TimerWrite(struct gb* gb, uint16_t addr);
+void TimerEvent(struct gb* gb);
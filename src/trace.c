@@ -0,0 +1,339 @@
+#include "trace.h"
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef TRACE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "disasm.h"
+
+struct trace_header {
+  char magic[4];
+  uint32_t version;
+  uint32_t count;  // entries following the header, oldest first
+};
+
+struct trace_block_header {
+  uint32_t size;    // encoded records
+  uint32_t stored;  // bytes following, deflated when smaller than size
+};
+
+#define TRACE_RECORD_MAX 17  // ctrl, mask, pc, sp, 8 registers, 3 bytes
+
+void TracePrint(FILE* out, const struct trace_entry* e) {
+  const struct Registers* reg = &e->reg;
+  char text[32];
+
+  DisasmInstr(text, sizeof(text), e->pc, e->bytes);
+  if (e->bytes[0]) fprintf(out, MAG "$%04X:%02X \t" RESET, e->pc, e->bytes[0]);
+  fprintf(out, "[INSTR] %s\n", text);
+  fprintf(out,
+          "AF: %04X BC: %04X DE: %04X HL: %04X SP: %04X "
+          "%c%c%c%c\n",
+          AF, BC, DE, HL, e->sp, GET_Z ? 'Z' : '_', GET_N ? 'N' : '_',
+          GET_H ? 'H' : '_', GET_C ? 'C' : '_');
+}
+
+int TraceDump(const struct trace* trace, const char* fileName) {
+  uint32_t count =
+      trace->head < TRACE_RING_SIZE ? trace->head : TRACE_RING_SIZE;
+  uint32_t first = trace->head - count;
+  struct trace_header header = {.magic = TRACE_MAGIC,
+                                .version = TRACE_VERSION,
+                                .count = count};
+
+  FILE* f = fopen(fileName, "wb");
+  if (!f) {
+    printf("[ERROR] %s: can't open %s\n", __func__, fileName);
+    return TRACE_ERROR_FILE;
+  }
+
+  fwrite(&header, sizeof(header), 1, f);
+  for (uint32_t i = 0; i < count; i++)
+    fwrite(&trace->ring[(first + i) & (TRACE_RING_SIZE - 1)],
+           sizeof(struct trace_entry), 1, f);
+  fclose(f);
+
+  printf("[INFO] Trace of %u instructions dumped at %s\n", count, fileName);
+
+  return TRACE_OK;
+}
+
+int TraceFormatDump(const char* fileName, FILE* out) {
+  struct trace_header header;
+  struct trace_entry e;
+  uint64_t cycles = 0;
+
+  FILE* f = fopen(fileName, "rb");
+  if (!f) {
+    printf("[ERROR] %s: file %s not found!\n", __func__, fileName);
+    return TRACE_ERROR_FILE;
+  }
+
+  if (fread(&header, sizeof(header), 1, f) != 1 ||
+      memcmp(header.magic, TRACE_MAGIC, 4) ||
+      header.version != TRACE_VERSION) {
+    printf("[ERROR] %s: %s is not a trace dump\n", __func__, fileName);
+    fclose(f);
+    return TRACE_ERROR_FORMAT;
+  }
+
+  for (uint32_t i = 0; i < header.count; i++) {
+    if (fread(&e, sizeof(e), 1, f) != 1) {
+      printf("[ERROR] %s: %s is truncated\n", __func__, fileName);
+      fclose(f);
+      return TRACE_ERROR_FORMAT;
+    }
+    TracePrint(out, &e);
+    cycles += e.cycles;
+  }
+  fclose(f);
+
+  fprintf(stderr, "[INFO] %u instructions, %llu cycles\n", header.count,
+          (unsigned long long)cycles);
+
+  return TRACE_OK;
+}
+
+static void TraceStreamReset(struct trace* trace) {
+  trace->used = 0;
+  memset(&trace->reg, 0, sizeof(trace->reg));
+  trace->sp = 0;
+  trace->next = 0;
+}
+
+static void TraceStreamFlush(struct trace* trace) {
+  struct trace_block_header header = {.size = trace->used,
+                                      .stored = trace->used};
+  const uint8_t* data = trace->block;
+
+  if (!trace->used) return;
+#ifdef TRACE_ZLIB
+  uLongf packed = compressBound(TRACE_BLOCK_SIZE);
+  if (compress2(trace->packed, &packed, trace->block, trace->used, 1) ==
+          Z_OK &&
+      packed < trace->used) {
+    header.stored = packed;
+    data = trace->packed;
+  }
+#endif
+  fwrite(&header, sizeof(header), 1, trace->file);
+  fwrite(data, 1, header.stored, trace->file);
+  TraceStreamReset(trace);
+}
+
+int TraceStreamOpen(struct trace* trace, const char* fileName) {
+  struct trace_header header = {.magic = TRACE_STREAM_MAGIC,
+                                .version = TRACE_STREAM_VERSION};
+
+  trace->file = fopen(fileName, "wb");
+  if (!trace->file) {
+    printf("[ERROR] %s: can't open %s\n", __func__, fileName);
+    return TRACE_ERROR_FILE;
+  }
+  // blocks go out in one write each, stdio buffering would only copy them
+  setvbuf(trace->file, NULL, _IONBF, 0);
+
+  trace->block = malloc(TRACE_BLOCK_SIZE);
+  bool memory = trace->block;
+#ifdef TRACE_ZLIB
+  trace->packed = malloc(compressBound(TRACE_BLOCK_SIZE));
+  memory = memory && trace->packed;
+#endif
+  if (!memory) {
+    printf("[ERROR] %s: no memory for the trace buffer\n", __func__);
+    fclose(trace->file);
+    free(trace->block);
+    free(trace->packed);
+    trace->file = NULL;
+    trace->block = trace->packed = NULL;
+    return TRACE_ERROR_MEMORY;
+  }
+  fwrite(&header, sizeof(header), 1, trace->file);
+  TraceStreamReset(trace);
+
+  return TRACE_OK;
+}
+
+void TraceStreamClose(struct trace* trace) {
+  if (!trace->file) return;
+
+  TraceStreamFlush(trace);
+  fclose(trace->file);
+  free(trace->block);
+  free(trace->packed);
+  trace->file = NULL;
+}
+
+void TraceStreamRecord(struct trace* trace, const struct cpu* cpu, uint16_t pc,
+                       uint8_t cycles) {
+  if (!trace->file) return;
+
+  const uint8_t* prev = (const uint8_t*)&trace->reg;
+  const uint8_t* reg = (const uint8_t*)&cpu->reg;
+  uint8_t* out = trace->block + trace->used;
+  uint8_t* ctrl = out++;
+  uint8_t* mask = out++;
+  int16_t delta = (int16_t)(pc - trace->next);
+
+  *ctrl = (cycles >> 2) << TRACE_CYCLES;
+  if (delta == 0) {
+    *ctrl |= TRACE_PC_NEXT;
+  } else if (delta >= -128 && delta <= 127) {
+    *ctrl |= TRACE_PC_REL;
+    *out++ = (uint8_t)delta;
+  } else {
+    *ctrl |= TRACE_PC_ABS;
+    *out++ = pc;
+    *out++ = pc >> 010;
+  }
+  if (cpu->sp != trace->sp) {
+    *ctrl |= TRACE_SP;
+    *out++ = cpu->sp;
+    *out++ = cpu->sp >> 010;
+    trace->sp = cpu->sp;
+  }
+
+  *mask = 0;
+  for (int i = 0; i < 8; i++) {
+    if (reg[i] != prev[i]) {
+      *mask |= 1 << i;
+      *out++ = reg[i];
+    }
+  }
+  trace->reg = cpu->reg;
+
+  uint8_t length = DisasmLengths[BusRead(cpu->bus, pc)];
+  for (uint8_t i = 0; i < length; i++) *out++ = BusRead(cpu->bus, pc + i);
+  trace->next = pc + length;
+
+  trace->used = out - trace->block;
+  if (trace->used > TRACE_BLOCK_SIZE - TRACE_RECORD_MAX)
+    TraceStreamFlush(trace);
+}
+
+// decodes one block of records and counts its instructions, false when a
+// record runs past the end of the block
+static bool TraceDecodeBlock(const uint8_t* in, uint32_t size, FILE* out,
+                             uint64_t* cycles, uint64_t* count) {
+  const uint8_t* end = in + size;
+  struct trace_entry e = {0};
+  uint8_t* reg = (uint8_t*)&e.reg;
+  uint16_t next = 0;
+
+  while (in < end) {
+    if (end - in < 2) return false;
+    uint8_t ctrl = *in++;
+    uint8_t mask = *in++;
+
+    // pc, sp and registers, then at least the opcode
+    int fields = (ctrl & TRACE_PC_MASK) == TRACE_PC_NEXT  ? 0
+                 : (ctrl & TRACE_PC_MASK) == TRACE_PC_REL ? 1
+                                                          : 2;
+    fields += (ctrl & TRACE_SP ? 2 : 0) + __builtin_popcount(mask);
+    if (end - in <= fields) return false;
+
+    switch (ctrl & TRACE_PC_MASK) {
+      case TRACE_PC_NEXT:
+        e.pc = next;
+        break;
+      case TRACE_PC_REL:
+        e.pc = next + (int8_t)*in++;
+        break;
+      default:
+        e.pc = in[0] | in[1] << 010;
+        in += 2;
+    }
+    if (ctrl & TRACE_SP) {
+      e.sp = in[0] | in[1] << 010;
+      in += 2;
+    }
+    for (int i = 0; i < 8; i++)
+      if (mask & (1 << i)) reg[i] = *in++;
+
+    uint8_t length = DisasmLengths[*in];
+    if (end - in < length) return false;
+    memset(e.bytes, 0, sizeof(e.bytes));
+    memcpy(e.bytes, in, length);
+    in += length;
+    next = e.pc + length;
+
+    e.cycles = (ctrl >> TRACE_CYCLES) << 2;
+    *cycles += e.cycles;
+    TracePrint(out, &e);
+    (*count)++;
+  }
+  return true;
+}
+
+int TraceFormatStream(const char* fileName, FILE* out) {
+  struct trace_header header;
+  struct trace_block_header block;
+  uint8_t* raw = malloc(TRACE_BLOCK_SIZE);
+  uint8_t* stored = malloc(TRACE_BLOCK_SIZE);
+  uint64_t cycles = 0, count = 0;
+  int state = TRACE_OK;
+
+  if (!raw || !stored) {
+    printf("[ERROR] %s: no memory for the trace blocks\n", __func__);
+    free(raw);
+    free(stored);
+    return TRACE_ERROR_MEMORY;
+  }
+  FILE* f = fopen(fileName, "rb");
+  if (!f) {
+    printf("[ERROR] %s: file %s not found!\n", __func__, fileName);
+    free(raw);
+    free(stored);
+    return TRACE_ERROR_FILE;
+  }
+
+  if (fread(&header, sizeof(header), 1, f) != 1 ||
+      memcmp(header.magic, TRACE_STREAM_MAGIC, 4) ||
+      header.version != TRACE_STREAM_VERSION) {
+    printf("[ERROR] %s: %s is not a trace stream\n", __func__, fileName);
+    state = TRACE_ERROR_FORMAT;
+  }
+
+  while (state == TRACE_OK && fread(&block, sizeof(block), 1, f) == 1) {
+    if (block.size > TRACE_BLOCK_SIZE || block.stored > block.size ||
+        fread(stored, 1, block.stored, f) != block.stored) {
+      printf("[ERROR] %s: %s is truncated\n", __func__, fileName);
+      state = TRACE_ERROR_FORMAT;
+      break;
+    }
+    const uint8_t* records = stored;
+    if (block.stored < block.size) {
+#ifdef TRACE_ZLIB
+      uLongf size = TRACE_BLOCK_SIZE;
+      if (uncompress(raw, &size, stored, block.stored) != Z_OK ||
+          size != block.size) {
+        printf("[ERROR] %s: bad block in %s\n", __func__, fileName);
+        state = TRACE_ERROR_FORMAT;
+        break;
+      }
+      records = raw;
+#else
+      printf("[ERROR] %s: %s is compressed, rebuild with ZLIB=1\n", __func__,
+             fileName);
+      state = TRACE_ERROR_FORMAT;
+      break;
+#endif
+    }
+    if (!TraceDecodeBlock(records, block.size, out, &cycles, &count)) {
+      printf("[ERROR] %s: bad block in %s\n", __func__, fileName);
+      state = TRACE_ERROR_FORMAT;
+    }
+  }
+
+  fclose(f);
+  free(raw);
+  free(stored);
+
+  if (state == TRACE_OK)
+    fprintf(stderr, "[INFO] %llu instructions, %llu cycles\n",
+            (unsigned long long)count, (unsigned long long)cycles);
+
+  return state;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "bus.h"
+#include "cpu.h"
+
+#define TRACE_OK 0
+#define TRACE_ERROR_FILE 1
+#define TRACE_ERROR_FORMAT 2
+#define TRACE_ERROR_MEMORY 3
+
+#define TRACE_RING_SIZE 0x10000  // entries, power of two
+#define TRACE_MAGIC "GBRT"
+#define TRACE_VERSION 1
+
+// streaming trace, a file header and blocks of variable length records. Each
+// block restarts the delta state so it decodes on its own and is stored
+// deflated when that is smaller (TRACE_ZLIB builds).
+#define TRACE_STREAM_MAGIC "GBTS"
+#define TRACE_STREAM_VERSION 1
+#define TRACE_BLOCK_SIZE 0x100000
+
+// record: control byte, register mask byte, optional pc and sp, the changed
+// registers in struct Registers order, then the instruction bytes
+#define TRACE_PC_NEXT 0  // pc follows the previous instruction
+#define TRACE_PC_REL 1   // i8 from there
+#define TRACE_PC_ABS 2   // u16
+#define TRACE_PC_MASK 3
+#define TRACE_SP 4        // u16 sp follows
+#define TRACE_CYCLES 3    // shift of cycles / 4 in the control byte
+
+// one executed instruction, registers as they were after it ran
+struct trace_entry {
+  uint16_t pc;
+  uint8_t bytes[3];  // opcode and the two bytes following it
+  uint8_t cycles;
+  struct Registers reg;
+  uint16_t sp;
+};
+
+__extension__ _Static_assert(sizeof(struct trace_entry) == 16,
+                             "trace entries are 16 bytes");
+
+// per machine trace, allocated by GbInit in builds with a trace tier
+struct trace {
+  struct trace_entry ring[TRACE_RING_SIZE];
+  uint32_t head;
+
+  // stream encoder, the previous record is reset at every block start
+  FILE* file;
+  uint8_t* block;
+  uint8_t* packed;
+  uint32_t used;
+  struct Registers reg;
+  uint16_t sp;
+  uint16_t next;
+};
+
+// Appends to the ring, formatting is left to TraceFormatDump.
+static inline void TraceRecord(struct trace* trace, const struct cpu* cpu,
+                               uint16_t pc, uint8_t cycles) {
+  struct trace_entry* e =
+      &trace->ring[trace->head++ & (TRACE_RING_SIZE - 1)];
+  e->pc = pc;
+  e->bytes[0] = BusRead(cpu->bus, pc);
+  e->bytes[1] = BusRead(cpu->bus, pc + 1);
+  e->bytes[2] = BusRead(cpu->bus, pc + 2);
+  e->cycles = cycles;
+  e->reg = cpu->reg;
+  e->sp = cpu->sp;
+}
+
+void TraceStreamRecord(struct trace* trace, const struct cpu* cpu, uint16_t pc,
+                       uint8_t cycles);
+
+// per instruction hooks for the cpu engines, see CPU_TRACE in cpu.h.
+// TRACE_RECORD only stores, TRACE_STEP also prints in PRINT builds.
+#if CPU_TRACE == CPU_TRACE_OFF
+#define TRACE_RECORD(gb, cpu, pc, cycles) ((void)(pc))
+#elif CPU_TRACE == CPU_TRACE_STREAM
+#define TRACE_RECORD(gb, cpu, pc, cycles) \
+  TraceStreamRecord((gb)->trace, cpu, pc, cycles)
+#else
+#define TRACE_RECORD(gb, cpu, pc, cycles) \
+  TraceRecord((gb)->trace, cpu, pc, cycles)
+#endif
+
+#if CPU_TRACE == CPU_TRACE_PRINT
+#define TRACE_STEP(gb, cpu, pc, cycles) \
+  (TraceRecord((gb)->trace, cpu, pc, cycles), CpuTrace(gb, cpu, pc))
+#else
+#define TRACE_STEP(gb, cpu, pc, cycles) TRACE_RECORD(gb, cpu, pc, cycles)
+#endif
+
+void TracePrint(FILE* out, const struct trace_entry* e);
+int TraceDump(const struct trace* trace, const char* fileName);
+int TraceFormatDump(const char* fileName, FILE* out);
+int TraceStreamOpen(struct trace* trace, const char* fileName);
+void TraceStreamClose(struct trace* trace);
+int TraceFormatStream(const char* fileName, FILE* out);
@@ -0,0 +1,27 @@
+// Offline trace decoder, prints the [INSTR] text of a trace stream
+// (TRACE=STREAM) or a dumped trace ring (TRACE=RING|PRINT).
+#include <stdio.h>
+#include <string.h>
+
+#include "trace.h"
+
+int main(int argc, char** argv) {
+  char magic[4];
+
+  if (argc != 2) {
+    printf("usage: %s <trace>\n", argv[0]);
+    return 1;
+  }
+
+  FILE* f = fopen(argv[1], "rb");
+  if (!f) {
+    printf("[ERROR] %s: file %s not found!\n", __func__, argv[1]);
+    return TRACE_ERROR_FILE;
+  }
+  size_t read = fread(magic, 1, sizeof(magic), f);
+  fclose(f);
+
+  if (read == sizeof(magic) && !memcmp(magic, TRACE_STREAM_MAGIC, 4))
+    return TraceFormatStream(argv[1], stdout);
+  return TraceFormatDump(argv[1], stdout);
+}
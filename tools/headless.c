@@ -0,0 +1,272 @@
+// Headless test runner. Runs every .gb in a directory on a pool of threads,
+// one machine per rom and as many at once as there are cores, and reports
+// what each rom printed over serial. Blargg's roms end their report with
+// Passed/Failed. With -c every rom also runs on a second machine that doesn't
+// skip idle loops, the two have to agree on the frame and cpu every frame.
+#define _POSIX_C_SOURCE 200809L
+
+#include <dirent.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "boot.h"
+#include "gb.h"
+
+#define MAX_ROMS 256
+#define MAX_THREADS 64
+#define OUTPUT_SIZE 0x10000  // serial bytes kept before a rom is stopped
+
+#define RUN_OK 0
+#define RUN_ERROR_ROM 1
+#define RUN_ERROR_CPU 2
+#define RUN_TIMEOUT 3
+#define RUN_MISMATCH 4
+
+struct job {
+  char name[256];
+  char* output;  // serial capture
+  size_t length;
+  double seconds;
+  int status;
+};
+
+struct pool {
+  struct job* jobs;
+  int count;
+  int next;  // first job nobody took yet
+  int passed;
+  const char* dir;
+  uint64_t limit;
+  bool verbose;
+  bool compare;
+  pthread_mutex_t lock;
+};
+
+static double Seconds(struct timespec from) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - from.tv_sec) + (now.tv_nsec - from.tv_nsec) / 1e9;
+}
+
+static bool Finished(const char* output) {
+  return strstr(output, "Passed") || strstr(output, "Failed");
+}
+
+// FNV-1a over the frame, the time and the cpu registers
+static uint64_t Hash(const struct gb* gb) {
+  const uint8_t* frame = (const uint8_t*)gb->ppu.frame;
+  uint64_t hash = 0xCBF29CE484222325ull;
+
+  for (size_t i = 0; i < sizeof(gb->ppu.screen); i++)
+    hash = (hash ^ frame[i]) * 0x100000001B3ull;
+  hash = (hash ^ gb->sched.now) * 0x100000001B3ull;
+  hash = (hash ^ (gb->cpu.pc | (uint32_t)gb->cpu.sp << 16)) * 0x100000001B3ull;
+  for (size_t i = 0; i < sizeof(gb->cpu.reg); i++)
+    hash = (hash ^ ((const uint8_t*)&gb->cpu.reg)[i]) * 0x100000001B3ull;
+  return hash;
+}
+
+static struct gb* Start(const struct cart* cart) {
+  struct gb* gb = malloc(sizeof(*gb));
+
+  if (gb && GbInit(gb, cart, NULL) != GB_OK) {
+    GbFree(gb);
+    free(gb);
+    return NULL;
+  }
+  return gb;
+}
+
+static void Stop(struct gb* gb) {
+  if (!gb) return;
+  if (gb->serial) fclose(gb->serial);
+  GbFree(gb);
+  free(gb);
+}
+
+// runs the rom from the post boot rom state until it reports or limit, the
+// reference machine is only there with -c
+static int RunRom(struct job* job, const char* fileName, uint64_t limit,
+                  bool compare) {
+  struct gb *gb = NULL, *ref = NULL;
+  struct cart cart;
+  char* refOutput = NULL;
+  size_t refLength;
+  int status = RUN_TIMEOUT;
+
+  if (BootMapRom(&cart, fileName)) return RUN_ERROR_ROM;
+  if (!(gb = Start(&cart)) || (compare && !(ref = Start(&cart)))) {
+    if (gb) GbFree(gb);
+    free(gb);
+    BootUnmapRom(&cart);
+    return RUN_ERROR_ROM;
+  }
+  gb->serial = open_memstream(&job->output, &job->length);
+  if (ref) {
+    ref->idle.off = true;
+    ref->serial = open_memstream(&refOutput, &refLength);
+  }
+  if (!gb->serial || (ref && !ref->serial)) {
+    printf("[ERROR] %s: can't capture the serial output of %s\n", __func__,
+           fileName);
+    status = RUN_ERROR_ROM;
+  }
+
+  // a frame at a time, the capture is only looked at in between
+  for (uint64_t until = 0; status == RUN_TIMEOUT && until < limit;) {
+    until = until + FRAME_CYCLES < limit ? until + FRAME_CYCLES : limit;
+    if (GbRun(gb, until) != CPU_OK) {
+      status = RUN_ERROR_CPU;
+      break;
+    }
+    if (ref && (GbRun(ref, until) != CPU_OK || Hash(ref) != Hash(gb))) {
+      status = RUN_MISMATCH;
+      break;
+    }
+    fflush(gb->serial);
+    if (Finished(job->output) || job->length >= OUTPUT_SIZE) {
+      status = RUN_OK;
+      break;
+    }
+  }
+
+  Stop(gb);
+  Stop(ref);
+  free(refOutput);
+  BootUnmapRom(&cart);
+  return status;
+}
+
+static const char* JobVerdict(const struct job* job) {
+  if (job->status == RUN_MISMATCH) return "HASH";
+  if (job->output && strstr(job->output, "Passed")) return "PASS";
+  if (job->output && strstr(job->output, "Failed")) return "FAIL";
+  switch (job->status) {
+    case RUN_ERROR_ROM:
+      return "ROM";
+    case RUN_ERROR_CPU:
+      return "CPU";
+    case RUN_TIMEOUT:
+      return "TIME";
+  }
+  return "FAIL";
+}
+
+// takes jobs until none are left, results are printed as they come in
+static void* Worker(void* arg) {
+  struct pool* pool = arg;
+  char path[512];
+
+  for (;;) {
+    pthread_mutex_lock(&pool->lock);
+    int i = pool->next < pool->count ? pool->next++ : -1;
+    pthread_mutex_unlock(&pool->lock);
+    if (i < 0) return NULL;
+
+    struct job* job = &pool->jobs[i];
+    struct timespec start;
+    snprintf(path, sizeof(path), "%s/%s", pool->dir, job->name);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    job->status = RunRom(job, path, pool->limit, pool->compare);
+    job->seconds = Seconds(start);
+
+    const char* verdict = JobVerdict(job);
+    pthread_mutex_lock(&pool->lock);
+    printf("%-4s %7.3fs  %s\n", verdict, job->seconds, job->name);
+    if (!strcmp(verdict, "PASS"))
+      pool->passed++;
+    else if (pool->verbose && job->output)
+      printf("%s\n", job->output);
+    fflush(stdout);
+    pthread_mutex_unlock(&pool->lock);
+  }
+}
+
+static int CompareNames(const void* a, const void* b) {
+  return strcmp(((const struct job*)a)->name, ((const struct job*)b)->name);
+}
+
+static void Usage(const char* name) {
+  printf(
+      "usage: %s [-c] [-j jobs] [-s seconds] [-v] <dir>\n"
+      "  -c  check idle loop skipping against a machine running every pass\n"
+      "  -j  roms run at once, default one per core\n"
+      "  -s  emulated seconds before a rom times out, default 120\n"
+      "  -v  print the serial output of roms that didn't pass\n",
+      name);
+}
+
+int main(int argc, char** argv) {
+  static struct job jobs[MAX_ROMS];
+  struct pool pool = {.jobs = jobs, .limit = 120ull * CPU_HZ};
+  long parallel = sysconf(_SC_NPROCESSORS_ONLN);
+  int opt;
+
+  while ((opt = getopt(argc, argv, "cj:s:v")) != -1) {
+    switch (opt) {
+      case 'c':
+        pool.compare = true;
+        break;
+      case 'j':
+        parallel = atol(optarg);
+        break;
+      case 's':
+        pool.limit = strtoull(optarg, NULL, 10) * CPU_HZ;
+        break;
+      case 'v':
+        pool.verbose = true;
+        break;
+      default:
+        Usage(argv[0]);
+        return 1;
+    }
+  }
+  if (optind != argc - 1 || parallel < 1) {
+    Usage(argv[0]);
+    return 1;
+  }
+  pool.dir = argv[optind];
+
+  DIR* d = opendir(pool.dir);
+  if (!d) {
+    printf("[ERROR] %s: directory %s not found!\n", __func__, pool.dir);
+    return 1;
+  }
+  struct dirent* entry;
+  while ((entry = readdir(d)) && pool.count < MAX_ROMS) {
+    size_t length = strlen(entry->d_name);
+    if (length < 4 || length >= sizeof(jobs[0].name) ||
+        strcmp(entry->d_name + length - 3, ".gb"))
+      continue;
+    strcpy(jobs[pool.count++].name, entry->d_name);
+  }
+  closedir(d);
+  qsort(jobs, pool.count, sizeof(jobs[0]), CompareNames);
+
+  if (parallel > MAX_THREADS) parallel = MAX_THREADS;
+  if (parallel > pool.count) parallel = pool.count;
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  pthread_t threads[MAX_THREADS];
+  pthread_mutex_init(&pool.lock, NULL);
+  for (long i = 0; i < parallel; i++) {
+    if (pthread_create(&threads[i], NULL, Worker, &pool)) {
+      printf("[ERROR] %s: can't start a worker\n", __func__);
+      return 1;
+    }
+  }
+  for (long i = 0; i < parallel; i++) pthread_join(threads[i], NULL);
+  pthread_mutex_destroy(&pool.lock);
+
+  for (int i = 0; i < pool.count; i++) free(jobs[i].output);
+  printf("%d/%d passed in %.3fs\n", pool.passed, pool.count, Seconds(start));
+  return pool.passed != pool.count;
+}
@@ -0,0 +1,163 @@
+// Save state benchmark and check. Runs a rom for a while, times SnapSave and
+// SnapLoad, then checks that a machine carries on exactly the same after a
+// load, in place and on a fresh machine, by hashing frame, memory and cpu.
+// Then a minute goes into the rewind buffer a frame at a time and is stepped
+// back through, every state has to come back as it was saved, and a small
+// ring is stepped back empty and filled again over and over.
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "boot.h"
+#include "gb.h"
+#include "rewind.h"
+#include "snap.h"
+
+#define ROUNDS 10000
+#define FRAMES 600  // run before the state is taken
+#define AFTER 120   // and after, for the comparison
+
+#define REWIND_FRAMES 3600       // one state each
+#define REWIND_BYTES (15 << 20)  // as the emulator's -r 60
+#define REFILL_ROUNDS 20
+
+static double Seconds(struct timespec from) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - from.tv_sec) + (now.tv_nsec - from.tv_nsec) / 1e9;
+}
+
+static uint64_t Fnv(uint64_t hash, const void* data, size_t size) {
+  for (size_t i = 0; i < size; i++)
+    hash = (hash ^ ((const uint8_t*)data)[i]) * 0x100000001B3ull;
+  return hash;
+}
+
+// runs frames more and hashes what a rom can see, plus the time
+static uint64_t RunHash(struct gb* gb, int frames) {
+  uint64_t hash = 0xCBF29CE484222325ull;
+
+  for (int i = 0; i < frames; i++) {
+    if (GbRun(gb, gb->sched.now + FRAME_CYCLES) != CPU_OK) break;
+    hash = Fnv(hash, gb->ppu.frame, sizeof(gb->ppu.screen));
+  }
+  hash = Fnv(hash, gb->ram + 0x8000, 0x8000);
+  hash = Fnv(hash, &gb->cpu.reg, sizeof(gb->cpu.reg));
+  hash = Fnv(hash, &gb->cpu.pc, sizeof(gb->cpu.pc));
+  hash = Fnv(hash, &gb->sched.now, sizeof(gb->sched.now));
+  return hash;
+}
+
+int main(int argc, char** argv) {
+  static struct gb gb, fresh;
+  struct cart cart;
+  struct timespec start;
+
+  if (argc != 2) {
+    printf("usage: %s <rom>\n", argv[0]);
+    return 1;
+  }
+  if (BootMapRom(&cart, argv[1]) || GbInit(&gb, &cart, NULL) ||
+      GbInit(&fresh, &cart, NULL))
+    return 1;
+  gb.serial = fresh.serial = fopen("/dev/null", "w");
+
+  RunHash(&gb, FRAMES);
+  size_t size = SnapSize(&gb);
+  uint8_t* state = malloc(size);
+  uint8_t* probe = malloc(size);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < ROUNDS; i++) {
+    SnapSave(&gb, state);
+    __asm__ volatile("" : : "r"(state) : "memory");
+  }
+  double save = Seconds(start) * 1e6 / ROUNDS;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < ROUNDS; i++)
+    if (SnapLoad(&gb, state, size) != SNAP_OK) return 1;
+  double load = Seconds(start) * 1e6 / ROUNDS;
+  printf("%zu bytes, save %.2f us, load %.2f us\n", size, save, load);
+
+  // the loads above put gb back where it was every time
+  uint64_t expect = RunHash(&gb, AFTER);
+  SnapLoad(&gb, state, size);
+  SnapSave(&gb, probe);
+  bool same = !memcmp(state, probe, size);
+  bool again = RunHash(&gb, AFTER) == expect;
+  bool moved = SnapLoad(&fresh, state, size) == SNAP_OK &&
+               RunHash(&fresh, AFTER) == expect;
+  printf("save after load %s, run after load %s, on a fresh machine %s\n",
+         same ? "same" : "DIFFERS", again ? "same" : "DIFFERS",
+         moved ? "same" : "DIFFERS");
+
+  // the ring drops states when full, only the ones kept are checked
+  static uint64_t hashes[REWIND_FRAMES];
+  struct rewind rewind;
+  double push = 0, step = 0;
+  int pushed = 0;
+  if (RewindInit(&rewind, &gb, 1, REWIND_FRAMES, REWIND_BYTES)) return 1;
+  for (; pushed < REWIND_FRAMES; pushed++) {
+    if (GbRun(&gb, gb.sched.now + FRAME_CYCLES) != CPU_OK) break;
+    SnapSave(&gb, state);
+    hashes[pushed] = Fnv(0xCBF29CE484222325ull, state, size);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    RewindPush(&rewind, &gb);
+    push += Seconds(start);
+  }
+  uint32_t kept = rewind.count;
+  size_t used = rewind.used;
+  bool back = kept > 0;
+  for (uint32_t i = 0; i < kept; i++) {
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    back &= RewindStep(&rewind, &gb);
+    step += Seconds(start);
+    SnapSave(&gb, state);
+    back &= Fnv(0xCBF29CE484222325ull, state, size) ==
+            hashes[pushed - 1 - i];
+  }
+  printf("rewind %u/%d states in %zu bytes, push %.2f us, step %.2f us, %s\n",
+         kept, pushed, used, push * 1e6 / (pushed ? pushed : 1),
+         step * 1e6 / (kept ? kept : 1), back ? "same" : "DIFFERS");
+  RewindFree(&rewind);
+
+  // A ring of a few states, wrapped, stepped back empty and filled again.
+  // WRAM is cleared and filled with noise in turns, so every other round
+  // starts with a keyframe much larger than the ones before, which then has
+  // to fit wherever the ring was left.
+  bool refill = !RewindInit(&rewind, &gb, 1, REWIND_KEY_EVERY, size / 4);
+  srand(1);
+  for (int round = 0; refill && round < REFILL_ROUNDS; round++) {
+    int count = 0;
+    for (int i = 0; i < 0x2000; i++)
+      gb.ram[0xC000 + i] = round % 2 ? rand() : 0;
+    for (; count < 2 * REWIND_KEY_EVERY + round * 7; count++) {
+      if (GbRun(&gb, gb.sched.now + FRAME_CYCLES) != CPU_OK) break;
+      SnapSave(&gb, state);
+      hashes[count] = Fnv(0xCBF29CE484222325ull, state, size);
+      RewindPush(&rewind, &gb);
+      refill &= rewind.head <= rewind.capacity;
+    }
+    for (int i = count - 1; rewind.count; i--) {
+      refill &= i >= 0 && RewindStep(&rewind, &gb);
+      SnapSave(&gb, state);
+      refill &= i >= 0 && Fnv(0xCBF29CE484222325ull, state, size) == hashes[i];
+    }
+    refill &= !RewindStep(&rewind, &gb);
+  }
+  printf("rewind emptied and filled again %s\n", refill ? "same" : "DIFFERS");
+  RewindFree(&rewind);
+
+  free(state);
+  free(probe);
+  GbFree(&gb);
+  GbFree(&fresh);
+  BootUnmapRom(&cart);
+  return !(same && again && moved && back && refill);
+}
@@ -0,0 +1,125 @@
+// Renderer microbenchmark. Decodes a VRAM's worth of random tiles with every
+// decoder this cpu runs and with the per pixel CHECK_BIT loop the window used
+// to decode with, then turns a frame of random shades into ARGB with every
+// shade converter. Each is checked against its scalar version and timed.
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "shade.h"
+#include "tile.h"
+
+#define TILES 384
+#define ROUNDS 20000
+#define FRAME_PIXELS (160 * 144)
+#define FRAMES 2000
+
+#ifndef CHECK_BIT
+#define CHECK_BIT(b, r) ((r & (1 << b)) == (1 << b))
+#endif
+
+// the old ReadTile, a palette lookup per pixel included
+static void TileDecodeCheckBit(const uint8_t* data, uint8_t out[8][8]) {
+  static const uint8_t palette[4] = {3, 2, 1, 0};
+  for (int_fast8_t y = 0; y < 8; y++) {
+    uint8_t lsb = *data++;
+    uint8_t msb = *data++;
+    for (int_fast8_t x = 0; x < 8; x++) {
+      uint8_t pixel = CHECK_BIT((7 - x), lsb) | CHECK_BIT((7 - x), msb) << 1;
+      out[y][x] = palette[pixel];
+    }
+  }
+}
+
+static double Seconds(struct timespec from) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - from.tv_sec) + (now.tv_nsec - from.tv_nsec) / 1e9;
+}
+
+static double Run(TileDecoder decode, const uint8_t* vram,
+                  uint8_t out[TILES][8][8]) {
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int round = 0; round < ROUNDS; round++) {
+    for (int tile = 0; tile < TILES; tile++)
+      decode(vram + tile * 16, out[tile]);
+    __asm__ volatile("" : : "r"(out) : "memory");  // keep every round
+  }
+  return Seconds(start) * 1e9 / ((double)ROUNDS * TILES);
+}
+
+static double RunShades(ShadeConverter convert, const uint8_t* frame,
+                        uint32_t* out) {
+  static const uint32_t Palette[4] = {0xFFE0F8D0, 0xFF88C070, 0xFF346856,
+                                      0xFF081820};
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int round = 0; round < FRAMES; round++) {
+    convert(out, frame, FRAME_PIXELS, Palette);
+    __asm__ volatile("" : : "r"(out) : "memory");
+  }
+  return Seconds(start) * 1e6 / FRAMES;
+}
+
+// every converter against the scalar one, us per frame
+static int BenchShades(void) {
+  static const char* Names[] = {"scalar", "pair", "ssse3"};
+  static uint8_t frame[FRAME_PIXELS];
+  static uint32_t expect[FRAME_PIXELS], out[FRAME_PIXELS];
+  int failed = 0;
+
+  printf("\n");
+  for (size_t i = 0; i < FRAME_PIXELS; i++) frame[i] = rand() & 0x03;
+  RunShades(ShadeConverterGet("scalar"), frame, expect);
+
+  for (size_t i = 0; i < sizeof(Names) / sizeof(Names[0]); i++) {
+    ShadeConverter convert = ShadeConverterGet(Names[i]);
+    if (!convert) {
+      printf("%-8s unsupported\n", Names[i]);
+      continue;
+    }
+    memset(out, 0, sizeof(out));
+    double us = RunShades(convert, frame, out);
+    bool same = !memcmp(out, expect, sizeof(out));
+    printf("%-8s %8.2f us/frame%s%s\n", Names[i], us,
+           convert == ShadeConverterBest() ? "  (used)" : "",
+           same ? "" : "  MISMATCH");
+    failed |= !same;
+  }
+  return failed;
+}
+
+int main(void) {
+  static const char* Names[] = {"scalar", "table", "sse2", "bmi2"};
+  static uint8_t vram[TILES * 16];
+  static uint8_t expect[TILES][8][8], out[TILES][8][8];
+  int failed = 0;
+
+  srand(1);
+  for (size_t i = 0; i < sizeof(vram); i++) vram[i] = rand();
+  for (int tile = 0; tile < TILES; tile++)
+    TileDecoderGet("scalar")(vram + tile * 16, expect[tile]);
+
+  printf("%-8s %8.2f ns/tile\n", "checkbit",
+         Run(TileDecodeCheckBit, vram, out));
+  for (size_t i = 0; i < sizeof(Names) / sizeof(Names[0]); i++) {
+    TileDecoder decode = TileDecoderGet(Names[i]);
+    if (!decode) {
+      printf("%-8s unsupported\n", Names[i]);
+      continue;
+    }
+    double ns = Run(decode, vram, out);
+    bool same = !memcmp(out, expect, sizeof(out));
+    printf("%-8s %8.2f ns/tile%s%s\n", Names[i], ns,
+           decode == TileDecoderBest() ? "  (used)" : "",
+           same ? "" : "  MISMATCH");
+    failed |= !same;
+  }
+  return failed | BenchShades();
+}